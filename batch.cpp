@@ -0,0 +1,114 @@
+#include "batch.h"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+
+namespace {
+
+struct Worker {
+  std::mutex          m;
+  std::deque<size_t>  tasks;
+};
+
+
+class MemoryBudget {
+public:
+  MemoryBudget(size_t cap) : _cap(cap), _used(0) {}
+
+  //-- blocks until the bytes fit, or until nothing else is running
+  size_t acquire(size_t bytes) {
+    if (_cap == 0)
+      return 0;
+    bytes = std::min(bytes, _cap);
+    std::unique_lock<std::mutex> lock(_m);
+    while ( (_used > 0) && (_used + bytes > _cap) )
+      _cv.wait(lock);
+    _used += bytes;
+    return bytes;
+  }
+
+  void release(size_t bytes) {
+    if (_cap == 0)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(_m);
+      _used -= bytes;
+    }
+    _cv.notify_all();
+  }
+
+private:
+  std::mutex              _m;
+  std::condition_variable _cv;
+  size_t                  _cap;
+  size_t                  _used;
+};
+
+
+bool pop_own(Worker& w, size_t& task) {
+  std::lock_guard<std::mutex> lock(w.m);
+  if (w.tasks.empty() == true)
+    return false;
+  task = w.tasks.front();
+  w.tasks.pop_front();
+  return true;
+}
+
+
+bool steal(Worker& w, size_t& task) {
+  std::lock_guard<std::mutex> lock(w.m);
+  if (w.tasks.empty() == true)
+    return false;
+  task = w.tasks.back();
+  w.tasks.pop_back();
+  return true;
+}
+
+
+void work(size_t self, std::vector<Worker>& workers, MemoryBudget& budget,
+          const std::vector<size_t>& memory, const std::function<void(size_t)>& task) {
+  size_t t;
+  for (;;) {
+    bool found = pop_own(workers[self], t);
+    //-- tasks are never added, so once every queue is empty the work is done
+    for (size_t i = 1; (found == false) && (i < workers.size()); i++)
+      found = steal(workers[(self + i) % workers.size()], t);
+    if (found == false)
+      return;
+    size_t reserved = budget.acquire(memory[t]);
+    task(t);
+    budget.release(reserved);
+  }
+}
+
+}
+
+
+void run_batch(const std::vector<size_t>& memory, int njobs, size_t memcap, const std::function<void(size_t)>& task) {
+  size_t n = memory.size();
+  if (n == 0)
+    return;
+  size_t nworkers = std::min((size_t)std::max(njobs, 1), n);
+  std::vector<size_t> order(n);
+  for (size_t i = 0; i < n; i++)
+    order[i] = i;
+  //-- biggest first, so that a big file is not the last one to start
+  std::stable_sort(order.begin(), order.end(), [&memory](size_t a, size_t b) { return memory[a] > memory[b]; });
+  std::vector<Worker> workers(nworkers);
+  for (size_t i = 0; i < n; i++)
+    workers[i % nworkers].tasks.push_back(order[i]);
+
+  MemoryBudget budget(memcap);
+  if (nworkers == 1) {
+    work(0, workers, budget, memory, task);
+    return;
+  }
+  std::vector<std::thread> pool;
+  for (size_t i = 0; i < nworkers; i++)
+    pool.push_back(std::thread(work, i, std::ref(workers), std::ref(budget), std::cref(memory), std::cref(task)));
+  for (size_t i = 0; i < pool.size(); i++)
+    pool[i].join();
+}
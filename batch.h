@@ -0,0 +1,16 @@
+#ifndef CITYGMLINFO_BATCH_H
+#define CITYGMLINFO_BATCH_H
+
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+
+//-- Runs task(i) for every i in [0, memory.size()) on njobs threads. The tasks
+//-- are dealt to the workers biggest first; a worker takes its own tasks from
+//-- the front of its queue and, once it is empty, steals from the back of the
+//-- others. memory[i] bytes are reserved from a budget of memcap bytes while
+//-- task i runs (memcap 0: no cap); a task bigger than the cap runs alone.
+void        run_batch(const std::vector<size_t>& memory, int njobs, size_t memcap, const std::function<void(size_t)>& task);
+
+#endif
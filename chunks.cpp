@@ -0,0 +1,256 @@
+#include "chunks.h"
+#include "input.h"
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <cstring>
+
+
+struct Chunk {
+  size_t                 begin;
+  size_t                 end;
+  pugi::xml_parse_result result;
+  Stats                  stats;
+};
+
+
+static bool is_space(char c) {
+  return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+
+//-- position right after the end of the markup starting at data[i] == '<', 0 if none
+static size_t markup_end(const char* data, size_t size, size_t i) {
+  const char* close = ">";
+  if (std::strncmp(data + i, "<?", 2) == 0)
+    close = "?>";
+  else if (std::strncmp(data + i, "<!--", 4) == 0)
+    close = "-->";
+  else if (std::strncmp(data + i, "<![CDATA[", 9) == 0)
+    close = "]]>";
+  if (close[0] != '>') {
+    const char* p = std::search(data + i, data + size, close, close + std::strlen(close));
+    return (p == data + size) ? 0 : (p - data) + std::strlen(close);
+  }
+  //-- tags and DOCTYPE: the first '>' outside quotes and [...]
+  char quote = 0;
+  int group = 0;
+  for (++i; i < size; i++) {
+    char c = data[i];
+    if (quote != 0) {
+      if (c == quote)
+        quote = 0;
+    }
+    else if (c == '"' || c == '\'')
+      quote = c;
+    else if (c == '[')
+      group++;
+    else if (c == ']' && group > 0)
+      group--;
+    else if (c == '>' && group == 0)
+      return i + 1;
+  }
+  return 0;
+}
+
+
+//-- start of the next "<prefix:cityObjectMember" at or after 'from' that directly follows
+//-- the end tag of the previous member (so it is neither nested nor in a comment)
+static size_t next_member(const char* data, size_t from, size_t to, const std::string& open, const std::string& close) {
+  while (from < to) {
+    const char* p = std::search(data + from, data + to, open.begin(), open.end());
+    if (p == data + to)
+      return to;
+    size_t i = p - data;
+    from = i + 1;
+    char after = data[i + open.size()];
+    if ( (after != '>') && (is_space(after) == false) )
+      continue;
+    size_t j = i;
+    while (j > 0 && is_space(data[j - 1]) == true)
+      j--;
+    if ( (j >= close.size()) && (std::memcmp(data + j - close.size(), close.data(), close.size()) == 0) )
+      return i;
+  }
+  return to;
+}
+
+
+//-- the root start tag, after the prolog (BOM, declaration, comments and DOCTYPE);
+//-- returns the position right after it, 0 if there is none
+static size_t root_start_tag(const char* data, size_t size, std::string& roottag, std::string& rootname) {
+  size_t rootbegin = (size >= 3 && std::memcmp(data, "\xef\xbb\xbf", 3) == 0) ? 3 : 0;
+  while (rootbegin < size) {
+    while (rootbegin < size && is_space(data[rootbegin]) == true)
+      rootbegin++;
+    if ( (rootbegin + 1 >= size) || (data[rootbegin] != '<') )
+      break;
+    if ( (data[rootbegin + 1] != '?') && (data[rootbegin + 1] != '!') )
+      break;
+    rootbegin = markup_end(data, size, rootbegin);
+    if (rootbegin == 0)
+      rootbegin = size;
+  }
+  size_t rootopen = (rootbegin < size && data[rootbegin] == '<') ? markup_end(data, size, rootbegin) : 0;
+  rootname.clear();
+  for (size_t i = rootbegin + 1; rootopen != 0 && i < rootopen && is_space(data[i]) == false && data[i] != '>' && data[i] != '/'; i++)
+    rootname += data[i];
+  roottag.clear();
+  if (rootopen != 0)
+    roottag.assign(data + rootbegin, rootopen - rootbegin);
+  return rootopen;
+}
+
+
+//-- the namespaces, from the root start tag alone
+static void root_namespaces(const std::string& roottag, const std::string& rootname, std::map<std::string, std::string>& ns, std::string& vcitygml) {
+  pugi::xml_document rootdoc;
+  if ( (rootname.empty() == false) && (roottag[roottag.size() - 2] != '/') &&
+       (rootdoc.load_string((roottag + "</" + rootname + ">").c_str())) ) {
+    std::vector<const char*> rootattrs;
+    node_attributes(rootdoc.first_child(), rootattrs);
+    get_namespaces(&rootattrs[0], ns, vcitygml);
+  }
+}
+
+
+bool head_namespaces(const char* path, std::map<std::string, std::string>& ns, std::string& vcitygml) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  std::vector<char> head(64 * 1024);
+  in.read(head.data(), head.size());
+  std::string roottag, rootname;
+  root_start_tag(head.data(), in.gcount(), roottag, rootname);
+  root_namespaces(roottag, rootname, ns, vcitygml);
+  return (vcitygml.empty() == false);
+}
+
+
+static void parse_chunk(const char* data, const std::string& roottag, const std::string& rootend, std::map<std::string, std::string> ns, int reports, bool xpath, bool skip, bool lazy, Chunk& chunk) {
+  size_t size = roottag.size() + (chunk.end - chunk.begin) + rootend.size();
+  char* buffer = static_cast<char*>(pugi::get_memory_allocation_function()(size));
+  if (buffer == NULL) {
+    chunk.result.status = pugi::status_out_of_memory;
+    return;
+  }
+  std::memcpy(buffer, roottag.data(), roottag.size());
+  std::memcpy(buffer + roottag.size(), data + chunk.begin, chunk.end - chunk.begin);
+  std::memcpy(buffer + roottag.size() + (chunk.end - chunk.begin), rootend.data(), rootend.size());
+  pugi::xml_document doc;
+  ReportFilter reportfilter(ns, reports, skip, lazy, chunk.stats);
+  if ( (skip == true) || (lazy == true) )
+    doc.set_parse_filter(&reportfilter);
+  chunk.result = doc.load_buffer_inplace_own(buffer, size);
+  if (!chunk.result)
+    return;
+  //-- the primitives are counted, and the extent computed, in the geometry
+  bool expand = (lazy == true) && (reads_coordinates(reports) == true);
+  if (xpath == true) {
+    if (expand == true)
+      chunk.result = expand_deferred(doc);
+    collect_xpath(doc, ns, reports, chunk.stats);
+  }
+  else {
+    StatsCollector collector(ns, reports, chunk.stats);
+    chunk.result = walk_document(doc, collector, expand);
+  }
+}
+
+
+pugi::xml_parse_result parallel_file(const char* path, int nthreads, std::map<std::string, std::string>& ns, std::string& vcitygml, int reports, bool xpath, bool skip, bool lazy, Stats& stats) {
+  pugi::xml_parse_result r;
+  r.status = pugi::status_ok;
+  MappedFile mapped;
+  std::vector<char> read;
+  char* data;
+  size_t size;
+  if (mapped.open(path) == true) {
+    data = mapped.data();
+    size = mapped.size();
+  }
+  else {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      r.status = pugi::status_file_not_found;
+      return r;
+    }
+    read.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data = read.data();
+    size = read.size();
+  }
+
+  std::string roottag, rootname;
+  size_t rootopen = root_start_tag(data, size, roottag, rootname);
+  std::string rootend = "</" + rootname + ">";
+  root_namespaces(roottag, rootname, ns, vcitygml);
+
+  //-- the root end tag closes the content
+  size_t rootclose = 0;
+  if (vcitygml.empty() == false) {
+    std::string closing = "</" + rootname;
+    size_t j = size;
+    while (j > rootopen && is_space(data[j - 1]) == true)
+      j--;
+    if (j > rootopen && data[j - 1] == '>') {
+      j--;
+      while (j > rootopen && is_space(data[j - 1]) == true)
+        j--;
+      if ( (j >= rootopen + closing.size()) && (std::memcmp(data + j - closing.size(), closing.data(), closing.size()) == 0) )
+        rootclose = j - closing.size();
+    }
+  }
+
+  std::vector<Chunk> chunks;
+  if (rootclose > rootopen) {
+    std::string open = "<" + ns["citygml"] + "cityObjectMember";
+    std::string close = "</" + ns["citygml"] + "cityObjectMember>";
+    size_t begin = rootopen;
+    for (int i = 1; i <= nthreads; i++) {
+      size_t end = (i == nthreads) ? rootclose : next_member(data, std::max(begin, rootopen + (rootclose - rootopen) * i / nthreads), rootclose, open, close);
+      if (end > begin) {
+        Chunk c;
+        c.begin = begin;
+        c.end = end;
+        chunks.push_back(c);
+        begin = end;
+      }
+    }
+  }
+
+  std::vector<std::thread> workers;
+  for (auto& c : chunks)
+    workers.push_back(std::thread(parse_chunk, data, std::cref(roottag), std::cref(rootend), ns, reports, xpath, skip, lazy, std::ref(c)));
+  for (auto& w : workers)
+    w.join();
+
+  bool ok = (chunks.empty() == false);
+  for (auto& c : chunks)
+    ok = ok && c.result;
+  if (ok == true) {
+    for (auto& c : chunks)
+      stats.merge(c.stats);
+    return r;
+  }
+
+  //-- no safe split, or a chunk is not well-formed: the whole file in one go
+  stats = Stats();
+  vcitygml.clear();
+  pugi::xml_document doc;
+  r = doc.load_buffer_inplace(data, size);
+  if (!r)
+    return r;
+  std::vector<const char*> rootattrs;
+  node_attributes(doc.first_child(), rootattrs);
+  get_namespaces(&rootattrs[0], ns, vcitygml);
+  if (vcitygml.empty() == false) {
+    if (xpath == true)
+      collect_xpath(doc, ns, reports, stats);
+    else {
+      StatsCollector collector(ns, reports, stats);
+      walk_document(doc, collector);
+    }
+  }
+  return r;
+}
@@ -0,0 +1,22 @@
+#ifndef CITYGMLINFO_CHUNKS_H
+#define CITYGMLINFO_CHUNKS_H
+
+#include <map>
+#include <string>
+#include "pugixml.hpp"
+#include "stats.h"
+
+
+//-- Splits the file at core:cityObjectMember boundaries into (at most) nthreads
+//-- chunks, parses each one in its own thread as a document of its own (the
+//-- root start tag with its namespace declarations is replayed in front of
+//-- each chunk) and merges the counters in file order. If a chunk cannot be
+//-- parsed the whole file is parsed at once, so errors are reported as usual.
+//-- With skip (walk engine only) or lazy the chunks are parsed through a ReportFilter.
+pugi::xml_parse_result parallel_file(const char* path, int nthreads, std::map<std::string, std::string>& ns, std::string& vcitygml, int reports, bool xpath, bool skip, bool lazy, Stats& stats);
+
+//-- the namespaces declared on the root element, read from the head of the file
+//-- alone (before the whole file is parsed); false if it is not CityGML
+bool        head_namespaces(const char* path, std::map<std::string, std::string>& ns, std::string& vcitygml);
+
+#endif
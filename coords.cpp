@@ -0,0 +1,319 @@
+#include "coords.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+static inline bool is_space(char c) {
+  return (c == ' ' || c == '\n' || c == '\t' || c == '\r');
+}
+
+
+static inline bool is_digit(char c) {
+  return (static_cast<unsigned char>(c - '0') < 10);
+}
+
+
+//-- the first character of s that is not whitespace; the whitespace between
+//-- the lines of a list is skipped 16 characters at a time
+static inline const char* skip_space(const char* s) {
+  if (is_space(*s) == false)
+    return s;
+  s++;
+  if (is_space(*s) == false)
+    return s;
+#ifdef __SSE2__
+  while (true) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+    __m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    unsigned int mask = ~static_cast<unsigned int>(_mm_movemask_epi8(space)) & 0xffff;
+    if (mask != 0)
+      return s + __builtin_ctz(mask);
+    s += 16;
+  }
+#else
+  while (is_space(*s) == true)
+    s++;
+  return s;
+#endif
+}
+
+
+//-- 8 digits at once in a 64-bit word (SWAR), for the long mantissas
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+static inline uint64_t read_eight(const char* s) {
+  uint64_t v;
+  std::memcpy(&v, s, 8);
+  return v;
+}
+
+
+static inline bool is_eight_digits(uint64_t v) {
+  return (((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+}
+
+
+static inline uint64_t eight_digits(uint64_t v) {
+  v -= 0x3030303030303030ull;
+  v = (v * 10) + (v >> 8);
+  return (((v & 0x000000FF000000FFull) * 0x000F424000000064ull) + (((v >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) >> 32;
+}
+#endif
+
+
+//-- the digits at s added to mantissa; returns the end of the digits
+static inline const char* read_digits(const char* s, uint64_t& mantissa) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+  while (is_eight_digits(read_eight(s)) == true) {
+    mantissa = mantissa * 100000000 + eight_digits(read_eight(s));
+    s += 8;
+  }
+#endif
+  while (is_digit(*s) == true) {
+    mantissa = mantissa * 10 + (*s - '0');
+    s++;
+  }
+  return s;
+}
+
+
+//-- strtod on a copy with '.' as decimal separator, for what the fast path cannot do exactly
+static const char* parse_double_slow(const char* s, char decimal, double& value) {
+  char buf[128];
+  size_t n = 0;
+  for (const char* p = s; n + 1 < sizeof(buf); p++, n++) {
+    char c = *p;
+    if (c == decimal)
+      c = '.';
+    else if ( (is_digit(c) == false) && (c != '+') && (c != '-') && (c != 'e') && (c != 'E') )
+      break;
+    buf[n] = c;
+  }
+  buf[n] = '\0';
+  char* end;
+  value = std::strtod(buf, &end);
+  return s + (end - buf);
+}
+
+
+const char* parse_double(const char* s, char decimal, double& value) {
+  static const double powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char* p = s;
+  bool negative = (*p == '-');
+  if ( (*p == '-') || (*p == '+') )
+    p++;
+  uint64_t mantissa = 0;
+  const char* digits = p;
+  p = read_digits(p, mantissa);
+  long ndigits = p - digits;
+  long exponent = 0;
+  if (*p == decimal) {
+    p++;
+    const char* fraction = p;
+    p = read_digits(p, mantissa);
+    exponent = -(p - fraction);
+    ndigits += p - fraction;
+  }
+  if (ndigits == 0)
+    return s;
+  //-- an 'e' without digits is not part of the number
+  if ( (*p == 'e') || (*p == 'E') ) {
+    const char* e = p + 1;
+    bool eneg = (*e == '-');
+    if ( (*e == '-') || (*e == '+') )
+      e++;
+    if (is_digit(*e) == true) {
+      long n = 0;
+      for ( ; is_digit(*e) == true; e++) {
+        if (n < 100000)
+          n = n * 10 + (*e - '0');
+      }
+      exponent += eneg ? -n : n;
+      p = e;
+    }
+  }
+  //-- exact: both the mantissa and the power of ten are doubles, and one
+  //-- IEEE operation rounds correctly
+  if ( (ndigits <= 19) && (mantissa <= (uint64_t(1) << 53)) && (exponent >= -22) && (exponent <= 22) ) {
+    double m = static_cast<double>(mantissa);
+    value = (exponent < 0) ? m / powers[-exponent] : m * powers[exponent];
+    if (negative == true)
+      value = -value;
+    return p;
+  }
+  return parse_double_slow(s, decimal, value);
+}
+
+
+CoordinateReader::CoordinateReader() :
+  _dimension(3),
+  _tuples(false),
+  _cs(','),
+  _ts(' '),
+  _decimal('.') {
+}
+
+
+void CoordinateReader::start_list(int dimension) {
+  _text.clear();
+  _values.clear();
+  _dimension = dimension;
+  _tuples = false;
+  _decimal = '.';
+}
+
+
+void CoordinateReader::start_tuples(int dimension, char cs, char ts, char decimal) {
+  _text.clear();
+  _values.clear();
+  _dimension = dimension;
+  _tuples = true;
+  _cs = cs;
+  _ts = ts;
+  _decimal = decimal;
+}
+
+
+bool CoordinateReader::finish() {
+  size_t size = _text.size();
+  _text.append(16, '\0');
+  const char* s = _text.data();
+  const char* end = s + size;
+  size_t tuple = 0;
+  size_t first = 0;   // numbers in the first tuple
+  bool ok = true;
+  while (true) {
+    s = skip_space(s);
+    if (s >= end)
+      break;
+    double v;
+    const char* e = parse_double(s, _decimal, v);
+    if ( (e == s) || (e > end) ) {
+      ok = false;
+      break;
+    }
+    _values.push_back(v);
+    s = e;
+    if (_tuples == true) {
+      tuple++;
+      if ( (*s == _cs) && (s < end) ) {
+        s++;
+        continue;
+      }
+      if (first == 0)
+        first = tuple;
+      tuple = 0;
+      if ( (*s == _ts) && (s < end) )
+        s++;
+      else if ( (is_space(*s) == false) && (s != end) ) {
+        ok = false;
+        break;
+      }
+    }
+    else if ( (is_space(*s) == false) && (s != end) ) {
+      ok = false;
+      break;
+    }
+  }
+  if (_dimension <= 0)
+    _dimension = (first > 0) ? first : 3;
+  _text.resize(size);
+  return ok;
+}
+
+
+Box::Box() {
+  for (int i = 0; i < 3; i++) {
+    min[i] = std::numeric_limits<double>::infinity();
+    max[i] = -std::numeric_limits<double>::infinity();
+  }
+}
+
+
+bool Box::contains(const Box& other) const {
+  for (int i = 0; i < 3; i++) {
+    //-- z is not compared if one of them has none
+    if ( (min[i] > max[i]) || (other.min[i] > other.max[i]) )
+      continue;
+    if ( (other.min[i] < min[i]) || (other.max[i] > max[i]) )
+      return false;
+  }
+  return true;
+}
+
+
+void Box::add(const Box& other) {
+  for (int i = 0; i < 3; i++) {
+    min[i] = std::min(min[i], other.min[i]);
+    max[i] = std::max(max[i], other.max[i]);
+  }
+}
+
+
+void Box::add(const std::vector<double>& values, int dimension) {
+  const double* p = values.data();
+  size_t n = values.size();
+  size_t i = 0;
+  if (dimension < 2)
+    return;
+#ifdef __SSE2__
+  if (dimension == 3) {
+    //-- 2 points are 3 registers: (x y) (z x) (y z)
+    __m128d lo[3], hi[3];
+    for (int k = 0; k < 3; k++) {
+      lo[k] = _mm_set1_pd(std::numeric_limits<double>::infinity());
+      hi[k] = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    }
+    for ( ; i + 6 <= n; i += 6) {
+      for (int k = 0; k < 3; k++) {
+        __m128d v = _mm_loadu_pd(p + i + 2 * k);
+        lo[k] = _mm_min_pd(lo[k], v);
+        hi[k] = _mm_max_pd(hi[k], v);
+      }
+    }
+    double l[6], h[6];
+    for (int k = 0; k < 3; k++) {
+      _mm_storeu_pd(l + 2 * k, lo[k]);
+      _mm_storeu_pd(h + 2 * k, hi[k]);
+    }
+    for (int k = 0; k < 6; k++) {
+      min[k % 3] = std::min(min[k % 3], l[k]);
+      max[k % 3] = std::max(max[k % 3], h[k]);
+    }
+  }
+  else if (dimension == 2) {
+    __m128d lo = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    __m128d hi = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    for ( ; i + 2 <= n; i += 2) {
+      __m128d v = _mm_loadu_pd(p + i);
+      lo = _mm_min_pd(lo, v);
+      hi = _mm_max_pd(hi, v);
+    }
+    double l[2], h[2];
+    _mm_storeu_pd(l, lo);
+    _mm_storeu_pd(h, hi);
+    for (int k = 0; k < 2; k++) {
+      min[k] = std::min(min[k], l[k]);
+      max[k] = std::max(max[k], h[k]);
+    }
+  }
+#endif
+  //-- what is left, and the other dimensions (only their first 3 coordinates)
+  int d = std::min(dimension, 3);
+  for ( ; i + dimension <= n; i += dimension) {
+    for (int k = 0; k < d; k++) {
+      min[k] = std::min(min[k], p[i + k]);
+      max[k] = std::max(max[k], p[i + k]);
+    }
+  }
+}
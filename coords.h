@@ -0,0 +1,65 @@
+#ifndef CITYGMLINFO_COORDS_H
+#define CITYGMLINFO_COORDS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+//-- Reads the numbers of a gml:posList or gml:pos (separated by whitespace), or
+//-- of a gml:coordinates (cs between the coordinates of a tuple, ts between the
+//-- tuples), into a vector of doubles reused from one element to the next, so
+//-- that no memory is allocated per number once it has grown.
+//-- The text is gathered first, since the pull parser may give it in pieces,
+//-- into a buffer padded for the 16-byte loads that split it.
+class CoordinateReader {
+public:
+  CoordinateReader();
+  //-- starts a list (posList, pos) or tuples (coordinates); dimension is the
+  //-- srsDimension in effect, 0 if none is declared
+  void        start_list(int dimension);
+  void        start_tuples(int dimension, char cs, char ts, char decimal);
+  void        append(const char* s, size_t length) { _text.append(s, length); }
+  //-- parses the text gathered, false if it is not a list of numbers
+  bool        finish();
+
+  const std::vector<double>& values() const { return _values; }
+  int         dimension() const { return _dimension; }
+  size_t      points() const { return _values.size() / _dimension; }
+
+private:
+  std::string         _text;
+  std::vector<double> _values;
+  int                 _dimension;
+  bool                _tuples;
+  char                _cs;
+  char                _ts;
+  char                _decimal;
+};
+
+
+//-- Axis-aligned box of points, empty until one is added; a box of 2D points
+//-- has no z (its z bounds stay infinite)
+struct Box {
+  double      min[3];
+  double      max[3];
+
+  Box();
+  bool        empty() const { return min[0] > max[0]; }
+  //-- only on the axes both have
+  bool        contains(const Box& other) const;
+  void        add(const Box& other);
+  //-- the points of a list of coordinates of the given dimension, 2 points
+  //-- (of 2 or 3 coordinates) at a time in SSE2 registers
+  void        add(const std::vector<double>& values, int dimension);
+};
+
+
+//-- Parses the number at s, which must be followed by 16 readable bytes;
+//-- returns the end of the number, or s if there is none. The numbers of up to
+//-- 19 digits that fit the 53 bits of a double with a power of ten up to 22
+//-- (all the usual coordinates) are converted exactly with one operation, the
+//-- others by strtod.
+const char* parse_double(const char* s, char decimal, double& value);
+
+#endif
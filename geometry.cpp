@@ -0,0 +1,43 @@
+#include "geometry.h"
+#include <cmath>
+
+
+void Sum::add(double v) {
+  double t = _sum + v;
+  if (std::fabs(_sum) >= std::fabs(v))
+    _error += (_sum - t) + v;
+  else
+    _error += (v - t) + _sum;
+  _sum = t;
+}
+
+
+double ring_measures(const double* points, size_t n, const double origin[3], double normal[3]) {
+  if (n < 3)
+    return 0.0;
+  double nx = 0.0, ny = 0.0, nz = 0.0;
+  double volume6 = 0.0;
+  double x0 = points[0] - origin[0];
+  double y0 = points[1] - origin[1];
+  double z0 = points[2] - origin[2];
+  //-- edges from p[i] to p[i + 1], closing the ring if its last point is not the first
+  for (size_t i = 0; i < n; i++) {
+    const double* a = points + 3 * i;
+    const double* b = points + 3 * ((i + 1) % n);
+    double ax = a[0] - origin[0], ay = a[1] - origin[1], az = a[2] - origin[2];
+    double bx = b[0] - origin[0], by = b[1] - origin[1], bz = b[2] - origin[2];
+    double cx = ay * bz - az * by;
+    double cy = az * bx - ax * bz;
+    double cz = ax * by - ay * bx;
+    nx += cx;
+    ny += cy;
+    nz += cz;
+    //-- the fan from the first point: p0 . (a x b) is 0 for the edges touching p0
+    volume6 += x0 * cx + y0 * cy + z0 * cz;
+  }
+  normal[0] += nx;
+  normal[1] += ny;
+  normal[2] += nz;
+  return volume6;
+}
+
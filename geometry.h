@@ -0,0 +1,32 @@
+#ifndef CITYGMLINFO_GEOMETRY_H
+#define CITYGMLINFO_GEOMETRY_H
+
+#include <cstddef>
+
+
+//-- Neumaier's compensated sum: the rounding error of each addition is kept
+//-- aside and added back at the end, so that the total of millions of areas or
+//-- volumes of very different sizes does not depend on their order.
+class Sum {
+public:
+  Sum() : _sum(0.0), _error(0.0) {}
+  void        add(double v);
+  void        add(const Sum& other) { add(other._sum); add(other._error); }
+  double      value() const { return _sum + _error; }
+
+private:
+  double      _sum;
+  double      _error;
+};
+
+
+//-- Adds to normal the Newell vector of a ring of n 3D points (twice its vector
+//-- area, so |normal| / 2 is the area of a planar polygon once all its rings are
+//-- added, the holes being oriented the other way) and returns 6 times the
+//-- signed volume of the cone from origin to the ring. Over a closed shell
+//-- oriented outwards these volumes add up to the volume inside (divergence
+//-- theorem). The points are taken relative to origin, which should be near
+//-- them so that large coordinates do not cancel out.
+double      ring_measures(const double* points, size_t n, const double origin[3], double normal[3]);
+
+#endif
@@ -0,0 +1,178 @@
+#include "input.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <dirent.h>
+#include <glob.h>
+#define CITYGMLINFO_HAS_MMAP
+#endif
+
+
+MappedFile::MappedFile() :
+  _data(NULL),
+  _size(0) {
+}
+
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+
+bool MappedFile::open(const char* path) {
+  close();
+#ifdef CITYGMLINFO_HAS_MMAP
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if ( (fstat(fd, &st) != 0) || (st.st_size == 0) ) {
+    ::close(fd);
+    return false;
+  }
+  void* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  //-- the mapping keeps its own reference to the file
+  ::close(fd);
+  if (p == MAP_FAILED)
+    return false;
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  _data = static_cast<char*>(p);
+  _size = st.st_size;
+  return true;
+#else
+  (void)path;
+  return false;
+#endif
+}
+
+
+void MappedFile::close() {
+#ifdef CITYGMLINFO_HAS_MMAP
+  if (_data != NULL)
+    munmap(_data, _size);
+#endif
+  _data = NULL;
+  _size = 0;
+}
+
+
+size_t peak_rss_kb() {
+#ifdef CITYGMLINFO_HAS_MMAP
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0;
+#ifdef __APPLE__
+  return ru.ru_maxrss / 1024;
+#else
+  return ru.ru_maxrss;
+#endif
+#else
+  return 0;
+#endif
+}
+
+
+size_t physical_memory() {
+#if defined(CITYGMLINFO_HAS_MMAP) && defined(_SC_PHYS_PAGES)
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long pagesize = sysconf(_SC_PAGESIZE);
+  if ( (pages <= 0) || (pagesize <= 0) )
+    return 0;
+  return (size_t)pages * (size_t)pagesize;
+#else
+  return 0;
+#endif
+}
+
+
+size_t file_size(const char* path) {
+#ifdef CITYGMLINFO_HAS_MMAP
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return 0;
+  return st.st_size;
+#else
+  FILE* f = fopen(path, "rb");
+  if (f == NULL)
+    return 0;
+  fseek(f, 0, SEEK_END);
+  long s = ftell(f);
+  fclose(f);
+  return (s < 0) ? 0 : s;
+#endif
+}
+
+
+#ifdef CITYGMLINFO_HAS_MMAP
+static bool is_citygml_name(const std::string& name) {
+  size_t dot = name.rfind('.');
+  if (dot == std::string::npos)
+    return false;
+  std::string ext = name.substr(dot + 1);
+  for (size_t i = 0; i < ext.size(); i++)
+    ext[i] = std::tolower((unsigned char)ext[i]);
+  return (ext == "gml" || ext == "xml");
+}
+
+
+static bool is_directory(const std::string& path) {
+  struct stat st;
+  return (stat(path.c_str(), &st) == 0) && S_ISDIR(st.st_mode);
+}
+
+
+static void list_directory(const std::string& dir, std::vector<std::string>& files) {
+  DIR* d = opendir(dir.c_str());
+  if (d == NULL)
+    return;
+  std::vector<std::string> found;
+  while (struct dirent* e = readdir(d)) {
+    std::string name = e->d_name;
+    if (name == "." || name == "..")
+      continue;
+    std::string path = (dir[dir.size() - 1] == '/') ? dir + name : dir + "/" + name;
+    if (is_directory(path) == true)
+      list_directory(path, found);
+    else if (is_citygml_name(name) == true)
+      found.push_back(path);
+  }
+  closedir(d);
+  std::sort(found.begin(), found.end());
+  files.insert(files.end(), found.begin(), found.end());
+}
+#endif
+
+
+void expand_inputs(const std::vector<std::string>& inputs, std::vector<std::string>& files) {
+  for (size_t i = 0; i < inputs.size(); i++) {
+#ifdef CITYGMLINFO_HAS_MMAP
+    const std::string& in = inputs[i];
+    if (is_directory(in) == true) {
+      list_directory(in, files);
+      continue;
+    }
+    if (in.find_first_of("*?[") != std::string::npos) {
+      glob_t g;
+      if (glob(in.c_str(), 0, NULL, &g) == 0) {
+        for (size_t j = 0; j < g.gl_pathc; j++) {
+          if (is_directory(g.gl_pathv[j]) == true)
+            list_directory(g.gl_pathv[j], files);
+          else
+            files.push_back(g.gl_pathv[j]);
+        }
+        globfree(&g);
+        continue;
+      }
+      globfree(&g);
+    }
+#endif
+    files.push_back(inputs[i]);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef CITYGMLINFO_INPUT_H
+#define CITYGMLINFO_INPUT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+//-- A private (copy-on-write) read-only-backed mapping of a whole file, so that
+//-- pugixml can parse it in place with load_buffer_inplace(): the parser writes
+//-- its terminators into copied pages and the rest stays clean page cache.
+//-- The document points into the mapping, so it has to outlive the document.
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+  bool        open(const char* path);
+  void        close();
+  char*       data() const { return _data; }
+  size_t      size() const { return _size; }
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  char*       _data;
+  size_t      _size;
+};
+
+
+//-- peak resident set size of the process so far, in kB (0 if unknown)
+size_t      peak_rss_kb();
+//-- physical memory of the machine in bytes (0 if unknown)
+size_t      physical_memory();
+//-- size of a file in bytes (0 if it cannot be read)
+size_t      file_size(const char* path);
+
+//-- Expands the command-line inputs into a list of files: a directory gives all
+//-- the .gml/.xml files below it (sorted), a pattern with *, ? or [ is globbed,
+//-- anything else is kept as is (so that a missing file is reported later).
+void        expand_inputs(const std::vector<std::string>& inputs, std::vector<std::string>& files);
+
+#endif
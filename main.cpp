@@ -1,21 +1,73 @@
 #include <tclap/CmdLine.h>
 #include <map>  
+#include <set>
+#include <mutex>
+#include <thread>
+#include <chrono>
 #include <string>  
 #include <time.h>  
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <iomanip>
 #include "pugixml.hpp"
 #include "boost/locale.hpp"
-
-
-void        report_primitives(pugi::xml_document& doc, std::map<std::string, std::string>& ns);
-void        report_building(pugi::xml_document& doc, std::map<std::string, std::string>& ns);
-void        report_building_each_lod(pugi::xml_document& doc, std::map<std::string, std::string>& ns, int lod, int& total_solid, int& total_ms, int& total_sem);
-void        report_relief(pugi::xml_document& doc, std::map<std::string, std::string>& ns);
-void        report_landuse(pugi::xml_document& doc, std::map<std::string, std::string>& ns);
+#include "stats.h"
+#include "input.h"
+#include "chunks.h"
+#include "batch.h"
+
+
+//-- how the files are read and which reports are computed
+struct Settings {
+  int         reports;
+  bool        xpath;
+  bool        mmap;
+  bool        stream;
+  bool        window;
+  int         threads;
+  bool        index;
+  bool        intern;
+  bool        internvalues;
+  bool        filter;
+  bool        lazy;
+};
+
+//-- what is kept of one file until it is printed
+struct FileResult {
+  Stats       stats;
+  std::string vcitygml;
+  std::string error;      // empty if the file could be read
+  size_t      rssbefore;
+  size_t      rssafter;
+  size_t      parsems;    // time to read the file into memory
+  size_t      indexbytes; // memory of the element index, 0 if none
+  pugi::xml_intern_stats interned;
+};
+
+
+bool        analyse_file(const std::string& path, const Settings& settings, FileResult& result);
+size_t      memory_estimate(const std::string& path, const Settings& settings);
+void        print_report(const Stats& stats, const std::string& vcitygml, int reports);
+void        print_classes(const Stats& stats);
+void        print_primitives(const Stats& stats);
+void        print_building(const Stats& stats);
+void        print_relief(const Stats& stats);
+void        print_landuse(const Stats& stats);
+void        print_water(const Stats& stats);
+void        print_vegetation(const Stats& stats);
+void        print_transportation(const Stats& stats);
+void        print_bridge(const Stats& stats);
+void        print_tunnel(const Stats& stats);
+void        print_cityfurniture(const Stats& stats);
+void        print_group(const Stats& stats);
+void        print_extent(const Stats& stats);
+void        print_geometry(const Stats& stats);
 void        print_info_aligned(std::string o, size_t number, bool tab = false);
-void        get_namespaces(pugi::xml_node& root, std::map<std::string, std::string>& ns, std::string& vcitygml);
-bool        contains_class(pugi::xml_node& root, std::string ns, std::string theclass);
+void        print_real_aligned(std::string o, double number, bool tab = false);
+void        print_sketch_aligned(std::string o, const QuantileSketch& sketch);
+void        print_box_aligned(std::string o, const Box& box);
+void        print_interned(const pugi::xml_intern_stats& interned, const Settings& settings);
 
 
 int main(int argc, char* const argv[])
@@ -25,12 +77,18 @@ int main(int argc, char* const argv[])
   std::locale::global(loc);
   std::cout.imbue(loc);
 
-  //-- XML namespaces map
-  std::map<std::string, std::string> ns;
-  
   TCLAP::CmdLine cmd("Allowed options", ' ', "0.3");
   try {
-    TCLAP::UnlabeledValueArg<std::string>  inputfile("inputfile", "The CityGML file", true, "", "string");
+    std::vector<std::string> engines;
+    engines.push_back("walk");
+    engines.push_back("xpath");
+    TCLAP::ValuesConstraint<std::string> engineconstraint(engines);
+    std::vector<std::string> simds;
+    simds.push_back("none");
+    simds.push_back("sse2");
+    simds.push_back("avx2");
+    TCLAP::ValuesConstraint<std::string> simdconstraint(simds);
+    TCLAP::UnlabeledMultiArg<std::string>  inputfiles("inputfiles", "The CityGML files, directories or patterns", true, "string");
     TCLAP::SwitchArg                       all("A", "all", "info about all classes", false);
     TCLAP::SwitchArg                       geomprimitive("G", "geomprimitives", "info about geometry primitives", false);
     TCLAP::SwitchArg                       building("B", "Building", "info about the Buildings", false);
@@ -39,6 +97,25 @@ int main(int argc, char* const argv[])
     TCLAP::SwitchArg                       vegetation("V", "Vegetation", "info about the Vegetation", false);
     TCLAP::SwitchArg                       landuse("L", "Landuse", "info about the Landuse", false);
     TCLAP::SwitchArg                       transportation("T", "Transportation", "info about the Transportation", false);
+    TCLAP::SwitchArg                       bridge("", "Bridge", "info about the Bridges", false);
+    TCLAP::SwitchArg                       tunnel("", "Tunnel", "info about the Tunnels", false);
+    TCLAP::SwitchArg                       cityfurniture("", "CityFurniture", "info about the CityFurniture", false);
+    TCLAP::SwitchArg                       group("", "CityObjectGroup", "info about the CityObjectGroups and their members", false);
+    TCLAP::SwitchArg                       extent("E", "extent", "bounding box of the dataset and of each class, against the declared gml:Envelope", false);
+    TCLAP::SwitchArg                       geometry("", "geometry", "volume and surface area of the Buildings per LOD", false);
+    TCLAP::ValueArg<std::string>           engine("", "engine", "walk: one traversal of the file for all reports (default); xpath: one query per counter", false, "walk", &engineconstraint);
+    TCLAP::SwitchArg                       mmapinput("", "mmap", "map the file in memory and parse it in place", false);
+    TCLAP::SwitchArg                       stream("", "stream", "read the file forward only without building it in memory (for files larger than RAM)", false);
+    TCLAP::SwitchArg                       window("", "window", "read the file forward only and build in memory one core:cityObjectMember at a time", false);
+    TCLAP::ValueArg<int>                   threads("", "threads", "number of threads parsing parts of the file in parallel", false, 1, "int");
+    TCLAP::ValueArg<int>                   jobs("", "jobs", "number of files processed at the same time (default: number of cores)", false, 0, "int");
+    TCLAP::ValueArg<int>                   memory("", "memory", "memory (in MB) the files processed at the same time may use (default: 3/4 of the RAM)", false, 0, "int");
+    TCLAP::SwitchArg                       index("", "index", "index the elements by name after loading, for the xpath engine", false);
+    TCLAP::SwitchArg                       intern("", "intern", "store each distinct element and attribute name once", false);
+    TCLAP::SwitchArg                       internvalues("", "intern-values", "store each distinct short attribute value and text once", false);
+    TCLAP::SwitchArg                       filter("", "filter", "build in memory only the elements the requested reports need (walk engine)", false);
+    TCLAP::SwitchArg                       lazy("", "lazy", "keep the geometry of the buildings unparsed until a report needs it", false);
+    TCLAP::ValueArg<std::string>           simd("", "simd", "instructions used to scan the text while parsing: none, sse2 or avx2 (default: the best the processor has)", false, "avx2", &simdconstraint);
     TCLAP::SwitchArg                       verbose("", "verbose", "verbose output", false);
 
     cmd.add(all);
@@ -49,160 +126,342 @@ int main(int argc, char* const argv[])
     cmd.add(vegetation);
     cmd.add(landuse);
     cmd.add(transportation);
+    cmd.add(bridge);
+    cmd.add(tunnel);
+    cmd.add(cityfurniture);
+    cmd.add(group);
+    cmd.add(extent);
+    cmd.add(geometry);
+    cmd.add(engine);
+    cmd.add(mmapinput);
+    cmd.add(stream);
+    cmd.add(window);
+    cmd.add(threads);
+    cmd.add(jobs);
+    cmd.add(memory);
+    cmd.add(index);
+    cmd.add(intern);
+    cmd.add(internvalues);
+    cmd.add(filter);
+    cmd.add(lazy);
+    cmd.add(simd);
     cmd.add(verbose);
-    cmd.add(inputfile);
+    cmd.add(inputfiles);
     cmd.parse( argc, argv );
 
-    std::cout << "Reading file: " << inputfile.getValue() << "... " << std::flush;
-    pugi::xml_document doc;
-    if (!doc.load_file(inputfile.getValue().c_str())) {
+    Settings settings;
+    settings.reports = REPORT_CLASSES;
+    if ( (all.getValue() == true) || (geomprimitive.getValue() == true) )
+      settings.reports |= REPORT_PRIMITIVES;
+    if ( (all.getValue() == true) || (building.getValue() == true) )
+      settings.reports |= REPORT_BUILDING;
+    if ( (all.getValue() == true) || (relief.getValue() == true) )
+      settings.reports |= REPORT_RELIEF;
+    if ( (all.getValue() == true) || (landuse.getValue() == true) )
+      settings.reports |= REPORT_LANDUSE;
+    if ( (all.getValue() == true) || (extent.getValue() == true) )
+      settings.reports |= REPORT_EXTENT;
+    if ( (all.getValue() == true) || (geometry.getValue() == true) )
+      settings.reports |= REPORT_GEOMETRY;
+    if ( (all.getValue() == true) || (water.getValue() == true) )
+      settings.reports |= REPORT_WATER;
+    if ( (all.getValue() == true) || (vegetation.getValue() == true) )
+      settings.reports |= REPORT_VEGETATION;
+    if ( (all.getValue() == true) || (transportation.getValue() == true) )
+      settings.reports |= REPORT_TRANSPORTATION;
+    if ( (all.getValue() == true) || (bridge.getValue() == true) )
+      settings.reports |= REPORT_BRIDGE;
+    if ( (all.getValue() == true) || (tunnel.getValue() == true) )
+      settings.reports |= REPORT_TUNNEL;
+    if ( (all.getValue() == true) || (cityfurniture.getValue() == true) )
+      settings.reports |= REPORT_CITYFURNITURE;
+    if ( (all.getValue() == true) || (group.getValue() == true) )
+      settings.reports |= REPORT_GROUP;
+    settings.xpath   = (engine.getValue() == "xpath");
+    settings.mmap    = mmapinput.getValue();
+    settings.stream  = stream.getValue();
+    settings.window  = window.getValue();
+    settings.threads = threads.getValue();
+    settings.index   = index.getValue();
+    settings.intern  = intern.getValue();
+    settings.internvalues = internvalues.getValue();
+    settings.filter  = filter.getValue() && (settings.xpath == false);
+    settings.lazy    = lazy.getValue();
+    if (simd.getValue() == "none")
+      pugi::set_simd_scanning(pugi::simd_none);
+    else if (simd.getValue() == "sse2")
+      pugi::set_simd_scanning(pugi::simd_sse2);
+
+    std::vector<std::string> files;
+    expand_inputs(inputfiles.getValue(), files);
+    if (files.empty() == true) {
       std::cerr << "File not found" << std::endl;
       return 0;
     }
-    std::cout << "done." << std::endl << std::endl;
-
-    //-- parse namespace
-    pugi::xml_node ncm = doc.first_child();
-    std::string vcitygml;
-    get_namespaces(ncm, ns, vcitygml);
 
-    if (vcitygml.empty() == true) {
-      std::cerr << "File does not have the CityGML namespace. Abort." << std::endl;
-      return 0;
+    //-- one file: same output as always, with progress while it is read
+    if (files.size() == 1) {
+      FileResult result;
+      std::cout << "Reading file: " << files[0] << "... " << std::flush;
+      if (analyse_file(files[0], settings, result) == false) {
+        std::cerr << result.error << std::endl;
+        return 0;
+      }
+      std::cout << "done." << std::endl << std::endl;
+      if (verbose.getValue() == true) {
+        std::cout << "Peak RSS before parsing (kB): " << boost::locale::as::number << result.rssbefore << std::endl;
+        std::cout << "Peak RSS after parsing (kB):  " << boost::locale::as::number << result.rssafter << std::endl;
+        std::cout << "Parsing time (ms):            " << boost::locale::as::number << result.parsems << std::endl;
+        std::cout << "SIMD scanning:                " << simds[pugi::get_simd_scanning()] << std::endl << std::endl;
+      }
+      if (settings.index == true)
+        std::cout << "Element index (kB): " << boost::locale::as::number << result.indexbytes / 1024 << std::endl << std::endl;
+      if ( (settings.intern == true) || (settings.internvalues == true) )
+        print_interned(result.interned, settings);
+      print_report(result.stats, result.vcitygml, settings.reports);
+      return 1;
     }
-    std::cout << "++++++++++++++++++++ GENERAL +++++++++++++++++++++" << std::endl;
-    std::cout << "CityGML version: " << vcitygml << std::endl;
-
-    // Appearance, Bridge, Building, CityFurniture, CityObjectGroup, Generics, LandUse, Relief, Transportation, Tunnel, Vegetation, WaterBody,
-    std::cout << "CityGML classes present: " << std::endl;
-    std::string s;
-    pugi::xpath_node no;
- 
-    if (contains_class(doc, ns["building"], "Building") == true)
-      std::cout << "    " << "Building" << std::endl;
-
-    if (contains_class(doc, ns["dem"], "ReliefFeature") == true)
-      std::cout << "    " << "Relief" << std::endl;
-
-    if ( (contains_class(doc, ns["veg"], "SolitaryVegetationObject") == true) ||
-         (contains_class(doc, ns["veg"], "PlantCover") == true) )
-      std::cout << "    " << "Vegetation" << std::endl;
-
-    if ( (contains_class(doc, ns["wtr"], "WaterBody") == true) ||
-         (contains_class(doc, ns["wtr"], "WaterClosureSurface") == true) || 
-         (contains_class(doc, ns["wtr"], "WaterGroundSurface") == true) || 
-         (contains_class(doc, ns["wtr"], "WaterSurface") == true) )
-      std::cout << "    " << "Water" << std::endl;
-
-    if (contains_class(doc, ns["luse"], "LandUse") == true)
-      std::cout << "    " << "LandUse" << std::endl;
-
-    if (contains_class(doc, ns["app"], "Appearance") == true)
-      std::cout << "    " << "Appearance" << std::endl;
-
-    if ( (contains_class(doc, ns["tran"], "TrafficArea") == true) ||
-         (contains_class(doc, ns["tran"], "TransportationComplex") == true) || 
-         (contains_class(doc, ns["tran"], "Track") == true) || 
-         (contains_class(doc, ns["tran"], "Railway") == true) || 
-         (contains_class(doc, ns["tran"], "Road") == true) || 
-         (contains_class(doc, ns["tran"], "Square") == true) || 
-         (contains_class(doc, ns["tran"], "AuxiliaryTrafficArea") == true) )
-      std::cout << "    " << "Water" << std::endl;
+
+    //-- many files: they are processed concurrently, but printed in the given
+    //-- order as soon as all the files before them are done
+    int njobs = jobs.getValue();
+    if (njobs <= 0)
+      njobs = std::max(1u, std::thread::hardware_concurrency());
+    size_t memcap = (size_t)std::max(memory.getValue(), 0) * 1024 * 1024;
+    if (memcap == 0)
+      memcap = physical_memory() / 4 * 3;
+    std::vector<size_t> estimates(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+      estimates[i] = memory_estimate(files[i], settings);
+
+    std::vector<FileResult> results(files.size());
+    std::vector<char> finished(files.size(), 0);
+    size_t nextprint = 0;
+    std::mutex printing;
+    Stats total;
+    std::set<std::string> versions;
+    size_t nerrors = 0;
+    run_batch(estimates, njobs, memcap, [&](size_t i) {
+      analyse_file(files[i], settings, results[i]);
+      std::lock_guard<std::mutex> lock(printing);
+      finished[i] = 1;
+      for ( ; (nextprint < files.size()) && (finished[nextprint] == 1); nextprint++) {
+        FileResult& r = results[nextprint];
+        std::cout << "Reading file: " << files[nextprint] << "... " << std::flush;
+        if (r.error.empty() == false) {
+          std::cerr << r.error << std::endl;
+          std::cout << std::endl;
+          nerrors++;
+          continue;
+        }
+        std::cout << "done." << std::endl << std::endl;
+        if (settings.index == true)
+          std::cout << "Element index (kB): " << boost::locale::as::number << r.indexbytes / 1024 << std::endl << std::endl;
+        if ( (settings.intern == true) || (settings.internvalues == true) )
+          print_interned(r.interned, settings);
+        print_report(r.stats, r.vcitygml, settings.reports);
+        std::cout << std::endl;
+        total.merge(r.stats);
+        versions.insert(r.vcitygml);
+        //-- only the totals are needed from now on
+        r = FileResult();
+      }
+    });
+
+    std::string vtotal;
+    for (std::set<std::string>::iterator it = versions.begin(); it != versions.end(); ++it)
+      vtotal += (vtotal.empty() ? "" : ", ") + *it;
+    std::cout << "++++++++++++++++++++ TOTAL +++++++++++++++++++++++" << std::endl;
+    print_info_aligned("Files", files.size());
+    print_info_aligned("Files with errors", nerrors);
+    if (verbose.getValue() == true)
+      print_info_aligned("Peak RSS (kB)", peak_rss_kb());
     std::cout << std::endl;
+    print_report(total, vtotal, settings.reports);
+    return (nerrors == 0) ? 1 : 0;
+  }
+  catch (TCLAP::ArgException &e) {
+    std::cout << "ERROR: " << e.error() << " for arg " << e.argId() << std::endl;
+    return(0);
+  }
+}
+
 
-    if (all.getValue() == true) {
-      report_primitives(doc, ns);
-      report_building(doc, ns);
-      report_relief(doc, ns);
-      report_landuse(doc, ns);
+bool analyse_file(const std::string& path, const Settings& settings, FileResult& result) {
+  //-- XML namespaces map
+  std::map<std::string, std::string> ns;
+  Stats& stats = result.stats;
+  std::string& vcitygml = result.vcitygml;
+  result.rssbefore = peak_rss_kb();
+  result.indexbytes = 0;
+  result.interned = pugi::xml_intern_stats();
+  unsigned int options = pugi::parse_default;
+  if (settings.intern == true)
+    options |= pugi::parse_intern_names;
+  if (settings.internvalues == true)
+    options |= pugi::parse_intern_values;
+  //-- declared before doc: with --mmap the DOM points into the mapping
+  MappedFile mapped;
+  pugi::xml_document doc;
+  //-- the filter needs the prefixes, which are read from the root start tag first
+  std::unique_ptr<ReportFilter> filter;
+  if ( ( (settings.filter == true) || (settings.lazy == true) ) && (head_namespaces(path.c_str(), ns, vcitygml) == true) ) {
+    filter.reset(new ReportFilter(ns, settings.reports, settings.filter, settings.lazy, stats));
+    doc.set_parse_filter(filter.get());
+  }
+  //-- the primitives are counted in the geometry, the other reports do without it
+  bool expand = (settings.lazy == true) && (reads_coordinates(settings.reports) == true);
+  pugi::xml_parse_result expanded;
+  expanded.status = pugi::status_ok;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if ( (settings.stream == true) || (settings.window == true) || (settings.threads > 1) ) {
+    //-- no DOM of the whole file: the counters are updated while the file is read
+    pugi::xml_parse_result r;
+    if (settings.stream == true)
+      r = stream_file(path.c_str(), ns, vcitygml, settings.reports, stats);
+    else if (settings.window == true)
+      r = window_file(path.c_str(), ns, vcitygml, settings.reports, settings.xpath, stats);
+    else
+      r = parallel_file(path.c_str(), settings.threads, ns, vcitygml, settings.reports, settings.xpath, settings.filter, settings.lazy, stats);
+    if (r.status == pugi::status_file_not_found || r.status == pugi::status_io_error) {
+      result.error = "File not found";
+      return false;
+    }
+    if (r.status == pugi::status_unsupported_encoding) {
+      result.error = "Unsupported encoding: --stream and --window read UTF-8 files only";
+      return false;
+    }
+    if (!r) {
+      std::ostringstream msg;
+      msg << "Parsing error: " << r.description() << " at offset " << r.offset;
+      result.error = msg.str();
+      return false;
     }
+  }
+  else if (settings.mmap == true) {
+    if ( (mapped.open(path.c_str()) == false) ||
+         (!doc.load_buffer_inplace(mapped.data(), mapped.size(), options)) ) {
+      result.error = "File not found";
+      return false;
+    }
+  }
+  else if (!doc.load_file(path.c_str(), options)) {
+    result.error = "File not found";
+    return false;
+  }
+  //-- expanded up front for the xpath engine, before the index that any change drops
+  if ( (expand == true) && (settings.xpath == true) )
+    expanded = expand_deferred(doc);
+  //-- the xpath engine then answers //qname from the index instead of a traversal
+  if ( (settings.index == true) && doc.first_child() )
+    result.indexbytes = doc.build_element_index();
+  result.interned = doc.intern_stats();
+  result.rssafter = peak_rss_kb();
+  result.parsems = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+  //-- parse namespace
+  if (doc.first_child()) {
+    std::vector<const char*> rootattrs;
+    node_attributes(doc.first_child(), rootattrs);
+    get_namespaces(&rootattrs[0], ns, vcitygml);
+  }
+
+  if (vcitygml.empty() == true) {
+    result.error = "File does not have the CityGML namespace. Abort.";
+    return false;
+  }
+
+  if (doc.first_child()) {
+    if (settings.xpath == true)
+      collect_xpath(doc, ns, settings.reports, stats);
     else {
-      if (geomprimitive.getValue() == true)
-        report_primitives(doc, ns);
-      if (building.getValue() == true)
-        report_building(doc, ns);
-      if (relief.getValue() == true)
-        report_relief(doc, ns);
-      // if (water.getValue() == true)
-        // report_primitives(doc, ns);
-      // if (vegetation.getValue() == true)
-        // report_primitives(doc, ns);
-      if (landuse.getValue() == true)
-        report_landuse(doc, ns);
-      // if (transportation.getValue() == true)
-        // report_primitives(doc, ns);
+      StatsCollector collector(ns, settings.reports, stats);
+      if (settings.intern == true)
+        collector.names_interned();
+      expanded = walk_document(doc, collector, expand);
     }
-    
-    return 1;
   }
-  catch (TCLAP::ArgException &e) {
-    std::cout << "ERROR: " << e.error() << " for arg " << e.argId() << std::endl;
-    return(0);
+  if (!expanded) {
+    std::ostringstream msg;
+    msg << "Parsing error: " << expanded.description() << " at offset " << expanded.offset;
+    result.error = msg.str();
+    return false;
   }
+  stats.finish_file();
+  return true;
 }
 
-bool contains_class(pugi::xml_node& root, std::string ns, std::string theclass) {
-  std::string s = "//" + ns + theclass + "[1]";
-  pugi::xpath_node no = root.select_node(s.c_str());
-  if (no != NULL)
-    return true;
-  return false;
+
+//-- rough peak memory of analysing the file, used to bound the files processed at once
+size_t memory_estimate(const std::string& path, const Settings& settings) {
+  size_t size = file_size(path.c_str());
+  //-- the forward-only modes use a buffer of 1MB (and a DOM of one city object)
+  if ( (settings.stream == true) || (settings.window == true) )
+    return std::min(size, (size_t)4 * 1024 * 1024);
+  //-- the DOM takes about twice the file; load_file also keeps a copy of the file
+  if ( (settings.mmap == true) || (settings.threads > 1) )
+    return 2 * size;
+  return 3 * size;
 }
 
-void get_namespaces(pugi::xml_node& root, std::map<std::string, std::string>& ns, std::string& vcitygml) {
-  vcitygml = "";
-  for (pugi::xml_attribute attr = root.first_attribute(); attr; attr = attr.next_attribute()) {
-    std::string name = attr.name();
-    if (name.find("xmlns") != std::string::npos) {
-      // std::cout << attr.name() << "=" << attr.value() << std::endl;
-      std::string value = attr.value();
-      std::string sns;
-      if (value.find("http://www.opengis.net/citygml/0") != std::string::npos) {
-        sns = "citygml";
-        vcitygml = "v0.4";
-      }
-      else if (value.find("http://www.opengis.net/citygml/1") != std::string::npos) {
-        sns = "citygml";
-        vcitygml = "v1.0";
-      }
-      else if (value.find("http://www.opengis.net/citygml/2") != std::string::npos) {
-        sns = "citygml";
-        vcitygml = "v2.0";
-      }
-      else if (value.find("http://www.opengis.net/gml") != std::string::npos)
-        sns = "gml";
-      else if (value.find("http://www.opengis.net/citygml/building") != std::string::npos)
-        sns = "building";
-      else if (value.find("http://www.opengis.net/citygml/relief") != std::string::npos)
-        sns = "dem";
-      else if (value.find("http://www.opengis.net/citygml/vegetation") != std::string::npos)
-        sns = "veg";
-      else if (value.find("http://www.opengis.net/citygml/waterbody") != std::string::npos)
-        sns = "wtr";
-      else if (value.find("http://www.opengis.net/citygml/landuse") != std::string::npos)
-        sns = "luse";
-      else if (value.find("http://www.opengis.net/citygml/transportation") != std::string::npos)
-        sns = "tran";      
-      else if (value.find("http://www.opengis.net/citygml/cityfurniture") != std::string::npos)
-        sns = "frn";      
-      else if (value.find("http://www.opengis.net/citygml/appearance") != std::string::npos)
-        sns = "app";      
-      else if (value.find("http://www.w3.org/1999/xlink") != std::string::npos)
-        sns = "xlink";
-      else
-        sns = "";
-      if (sns != "") {
-        size_t pos = name.find(":");
-        if (pos == std::string::npos) 
-          ns[sns] = "";
-        else 
-          ns[sns] = name.substr(pos + 1) + ":";
-      }    
-    }
+
+void print_interned(const pugi::xml_intern_stats& interned, const Settings& settings) {
+  //-- every occurrence would be a string of its own in a DOM built without a parse buffer
+  if (settings.intern == true) {
+    size_t kept = interned.unique_name_bytes + interned.table_bytes;
+    std::cout << "Interned names: " << boost::locale::as::number << interned.names << " ("
+              << interned.name_bytes / 1024 << " kB as separate strings, "
+              << kept / 1024 << " kB interned, "
+              << (interned.name_bytes > kept ? interned.name_bytes - kept : 0) / 1024 << " kB saved)" << std::endl;
+  }
+  if (settings.internvalues == true) {
+    //-- the table of the values is released after parsing
+    size_t kept = interned.unique_value_bytes;
+    size_t hits = interned.values - interned.unique_values;
+    std::cout << "Interned values: " << boost::locale::as::number << interned.values << " ("
+              << interned.unique_values << " distinct, "
+              << (interned.values > 0 ? hits * 100 / interned.values : 0) << "% hits, "
+              << interned.value_bytes / 1024 << " kB as separate strings, "
+              << kept / 1024 << " kB interned, "
+              << (interned.value_bytes > kept ? interned.value_bytes - kept : 0) / 1024 << " kB saved)" << std::endl;
   }
+  std::cout << std::endl;
 }
 
 
+void print_report(const Stats& stats, const std::string& vcitygml, int reports) {
+  std::cout << "++++++++++++++++++++ GENERAL +++++++++++++++++++++" << std::endl;
+  std::cout << "CityGML version: " << vcitygml << std::endl;
+  print_classes(stats);
+
+  if (reports & REPORT_PRIMITIVES)
+    print_primitives(stats);
+  if (reports & REPORT_BUILDING)
+    print_building(stats);
+  if (reports & REPORT_RELIEF)
+    print_relief(stats);
+  if (reports & REPORT_LANDUSE)
+    print_landuse(stats);
+  if (reports & REPORT_WATER)
+    print_water(stats);
+  if (reports & REPORT_VEGETATION)
+    print_vegetation(stats);
+  if (reports & REPORT_TRANSPORTATION)
+    print_transportation(stats);
+  if (reports & REPORT_BRIDGE)
+    print_bridge(stats);
+  if (reports & REPORT_TUNNEL)
+    print_tunnel(stats);
+  if (reports & REPORT_CITYFURNITURE)
+    print_cityfurniture(stats);
+  if (reports & REPORT_GROUP)
+    print_group(stats);
+  if (reports & REPORT_EXTENT)
+    print_extent(stats);
+  if (reports & REPORT_GEOMETRY)
+    print_geometry(stats);
+}
+
 void print_info_aligned(std::string o, size_t number, bool tab) {
   if (tab == false)
     std::cout << std::setw(40) << std::left  << o;
@@ -212,195 +471,356 @@ void print_info_aligned(std::string o, size_t number, bool tab) {
 }
 
 
-void report_primitives(pugi::xml_document& doc, std::map<std::string, std::string>& ns) {
-  std::cout << "+++++++++++++++++++ PRIMITIVES +++++++++++++++++++" << std::endl;
-  
-  std::string s = "//" + ns["gml"] + "Solid";
-  print_info_aligned("gml:Solid", doc.select_nodes(s.c_str()).size());
+void print_real_aligned(std::string o, double number, bool tab) {
+  if (tab == false)
+    std::cout << std::setw(40) << std::left  << o;
+  else
+    std::cout << "    " << std::setw(36) << std::left  << o;
+  std::ios::fmtflags flags = std::cout.flags();
+  std::streamsize precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << std::setw(10) << std::right << boost::locale::as::number << number << std::endl;
+  std::cout.flags(flags);
+  std::cout.precision(precision);
+}
+
+
+void print_sketch_aligned(std::string o, const QuantileSketch& sketch) {
+  if (sketch.count() == 0)
+    return;
+  std::cout << o << std::endl;
+  print_info_aligned("min", static_cast<size_t>(sketch.min()), true);
+  print_info_aligned("p50", static_cast<size_t>(sketch.quantile(0.50)), true);
+  print_info_aligned("p95", static_cast<size_t>(sketch.quantile(0.95)), true);
+  print_info_aligned("p99", static_cast<size_t>(sketch.quantile(0.99)), true);
+  print_info_aligned("max", static_cast<size_t>(sketch.max()), true);
+}
+
+
+void print_box_aligned(std::string o, const Box& box) {
+  if (box.empty() == true) {
+    std::cout << std::setw(40) << std::left << o << std::setw(10) << std::right << "none" << std::endl;
+    return;
+  }
+  std::cout << o << std::endl;
+  std::ios::fmtflags flags = std::cout.flags();
+  std::streamsize precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(3);
+  for (int corner = 0; corner < 2; corner++) {
+    const double* c = (corner == 0) ? box.min : box.max;
+    std::cout << "    " << std::setw(6) << std::left << ((corner == 0) ? "min" : "max") << std::right;
+    for (int i = 0; i < 3; i++) {
+      //-- no z for 2D coordinates
+      if (box.min[i] > box.max[i])
+        std::cout << std::setw(16) << "-";
+      else
+        std::cout << std::setw(16) << boost::locale::as::number << c[i];
+    }
+    std::cout << std::endl;
+  }
+  std::cout.flags(flags);
+  std::cout.precision(precision);
+}
+
+
+void print_classes(const Stats& stats) {
+  // Appearance, Bridge, Building, CityFurniture, CityObjectGroup, Generics, LandUse, Relief, Transportation, Tunnel, Vegetation, WaterBody,
+  std::cout << "CityGML classes present: " << std::endl;
+  if (stats.contains(TAG_BUILDING) == true)
+    std::cout << "    " << "Building" << std::endl;
+
+  if (stats.contains(TAG_RELIEFFEATURE) == true)
+    std::cout << "    " << "Relief" << std::endl;
+
+  if ( (stats.contains(TAG_SOLITARYVEGETATIONOBJECT) == true) ||
+       (stats.contains(TAG_PLANTCOVER) == true) )
+    std::cout << "    " << "Vegetation" << std::endl;
+
+  if ( (stats.contains(TAG_WATERBODY) == true) ||
+       (stats.contains(TAG_WATERCLOSURESURFACE) == true) || 
+       (stats.contains(TAG_WATERGROUNDSURFACE) == true) || 
+       (stats.contains(TAG_WATERSURFACE) == true) )
+    std::cout << "    " << "Water" << std::endl;
+
+  if (stats.contains(TAG_LANDUSE) == true)
+    std::cout << "    " << "LandUse" << std::endl;
 
-  s = "//" + ns["gml"] + "MultiSolid";
-  print_info_aligned("gml:MultiSolid", doc.select_nodes(s.c_str()).size());
+  if (stats.contains(TAG_APPEARANCE) == true)
+    std::cout << "    " << "Appearance" << std::endl;
 
-  s = "//" + ns["gml"] + "CompositeSolid";
-  print_info_aligned("gml:CompositeSolid", doc.select_nodes(s.c_str()).size());
-  
-  s = "//" + ns["gml"] + "MultiSurface";
-  print_info_aligned("gml:MultiSurface", doc.select_nodes(s.c_str()).size());
-  
-  s = "//" + ns["gml"] + "CompositeSurface";
-  print_info_aligned("gml:CompositeSurface", doc.select_nodes(s.c_str()).size());
+  if ( (stats.contains(TAG_TRAFFICAREA) == true) ||
+       (stats.contains(TAG_TRANSPORTATIONCOMPLEX) == true) || 
+       (stats.contains(TAG_TRACK) == true) || 
+       (stats.contains(TAG_RAILWAY) == true) || 
+       (stats.contains(TAG_ROAD) == true) || 
+       (stats.contains(TAG_SQUARE) == true) || 
+       (stats.contains(TAG_AUXILIARYTRAFFICAREA) == true) )
+    std::cout << "    " << "Transportation" << std::endl;
 
-  s = "//" + ns["gml"] + "Polygon";
-  print_info_aligned("gml:Polygon", doc.select_nodes(s.c_str()).size());
+  if (stats.contains(TAG_BRIDGE) == true)
+    std::cout << "    " << "Bridge" << std::endl;
 
+  if (stats.contains(TAG_TUNNEL) == true)
+    std::cout << "    " << "Tunnel" << std::endl;
+
+  if (stats.contains(TAG_CITYFURNITURE) == true)
+    std::cout << "    " << "CityFurniture" << std::endl;
+
+  if (stats.contains(TAG_CITYOBJECTGROUP) == true)
+    std::cout << "    " << "CityObjectGroup" << std::endl;
   std::cout << std::endl;
 }
 
 
-void report_building_each_lod(pugi::xml_document& doc, std::map<std::string, std::string>& ns, int lod, int& total_solid, int& total_ms, int& total_sem) {
-  total_solid = 0;
-  total_ms = 0;
-  total_sem = 0;
-  std::string slod = "lod" + std::to_string(lod);
-  std::string s = "//" + ns["building"] + "Building";
-  pugi::xpath_node_set nb = doc.select_nodes(s.c_str());
-  for (auto& b : nb) {
-    std::string s1 = ".//" + ns["building"] + slod + "Solid";
-    pugi::xpath_node_set tmp = b.node().select_nodes(s1.c_str());
-    if (tmp.empty() == false) {
-      for (auto& nbp : tmp) {
-        total_solid++;
-        break;
-      }
-    }
-    s1 = "./" + ns["building"] + slod + "MultiSurface";
-    tmp = b.node().select_nodes(s1.c_str());
-    if (tmp.empty() == false) {
-      for (auto& nbp : tmp) {
-        total_ms++;
-        break;
-      }
-    }
-    s1 = "./" + ns["building"] + "boundedBy" + "//" + ns["building"] + slod + "MultiSurface";
-    tmp = b.node().select_nodes(s1.c_str());
-    if (tmp.empty() == false) {
-      for (auto& nbp : tmp) {
-        total_sem++;
-        break;
-      }
-    }
+void print_primitives(const Stats& stats) {
+  std::cout << "+++++++++++++++++++ PRIMITIVES +++++++++++++++++++" << std::endl;
+  print_info_aligned("gml:Solid", stats.tags[TAG_SOLID]);
+  print_info_aligned("gml:MultiSolid", stats.tags[TAG_MULTISOLID]);
+  print_info_aligned("gml:CompositeSolid", stats.tags[TAG_COMPOSITESOLID]);
+  print_info_aligned("gml:MultiSurface", stats.tags[TAG_MULTISURFACE]);
+  print_info_aligned("gml:CompositeSurface", stats.tags[TAG_COMPOSITESURFACE]);
+  print_info_aligned("gml:Polygon", stats.tags[TAG_POLYGON]);
+  print_info_aligned("Points", stats.points);
+  print_sketch_aligned("Vertices per ring", stats.ring_vertices);
+  print_sketch_aligned("Rings per polygon", stats.polygon_rings);
+  print_sketch_aligned("Polygons per Building", stats.building_polygons);
+  for (int lod = 1; lod <= 4; lod++) {
+    if (stats.building_polygons_lod[lod].count() > 0)
+      print_sketch_aligned("Polygons per Building in LOD" + std::to_string(lod), stats.building_polygons_lod[lod]);
   }
+  std::cout << std::endl;
 }
 
 
-void report_building(pugi::xml_document& doc, std::map<std::string, std::string>& ns) {
+void print_building(const Stats& stats) {
   std::cout << "++++++++++++++++++++ BUILDINGS +++++++++++++++++++" << std::endl;
-  
-  std::string s = "//" + ns["building"] + "Building";
-  int nobuildings = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("Building", nobuildings);
-
-  s = "//" + ns["building"] + "Building" + "/" + ns["building"] + "consistsOfBuildingPart" + "[1]";
-  int nobwbp = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("without BuildingPart", (nobuildings - nobwbp), true);
-  print_info_aligned("having BuildingPart", nobwbp, true);
-  s = "//" + ns["building"] + "Building" + "[@" + ns["gml"] + "id]";
-  print_info_aligned("with gml:id", doc.select_nodes(s.c_str()).size(), true);
-
-  s = "//" + ns["building"] + "BuildingPart";
-  int nobuildingparts = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("BuildingPart", nobuildingparts);
-  s = "//" + ns["building"] + "BuildingPart" + "[@" + ns["gml"] + "id]";
-  print_info_aligned("with gml:id", doc.select_nodes(s.c_str()).size(), true);
-  
+  size_t tally[BF_COUNT];
+  stats.tally_buildings(tally);
+  print_info_aligned("Building", stats.tags[TAG_BUILDING]);
+  print_info_aligned("without BuildingPart", (stats.tags[TAG_BUILDING] - tally[BF_PART]), true);
+  print_info_aligned("having BuildingPart", tally[BF_PART], true);
+  print_info_aligned("with gml:id", tally[BF_ID], true);
+  print_info_aligned("BuildingPart", stats.tags[TAG_BUILDINGPART]);
+  print_info_aligned("with gml:id", stats.buildingpart_with_id, true);
+
   std::cout << "LOD0" << std::endl;
-  int total_footprint = 0;
-  int total_roofedge = 0;
-  s = "//" + ns["building"] + "Building";
-  pugi::xpath_node_set nb = doc.select_nodes(s.c_str());
-  for (auto& b : nb) {
-    std::string s1 = ".//" + ns["building"] + "lod0FootPrint";
-    pugi::xpath_node_set tmp = b.node().select_nodes(s1.c_str());
-    if (tmp.empty() == false) {
-      for (auto& nbp : tmp) {
-        total_footprint++;
-        break;
-      }
-    }
-    s1 = ".//" + ns["building"] + "lod0RoofEdge";
-    tmp = b.node().select_nodes(s1.c_str());
-    if (tmp.empty() == false) {
-      for (auto& nbp : tmp) {
-        total_roofedge++;
-        break;
-      }
-    }
-  }
-  print_info_aligned("Building with FootPrint", total_footprint, true);
-  print_info_aligned("Building with RoofEdge", total_roofedge, true);
-  
+  print_info_aligned("Building with FootPrint", tally[BF_FOOTPRINT], true);
+  print_info_aligned("Building with RoofEdge", tally[BF_ROOFEDGE], true);
   for (int lod = 1; lod <= 4; lod++) {
     std::cout << "LOD" << lod << std::endl;
-    int totals = 0;
-    int totalms = 0;
-    int totalsem = 0;
-    report_building_each_lod(doc, ns, lod, totals, totalms, totalsem);
-    print_info_aligned("Building stored in gml:Solid", totals, true);
-    print_info_aligned("Building stored in gml:MultiSurface", totalms, true);
-    print_info_aligned("Building with semantics for surfaces", totalsem, true);
+    print_info_aligned("Building stored in gml:Solid", tally[bf_solid(lod)], true);
+    print_info_aligned("Building stored in gml:MultiSurface", tally[bf_ms(lod)], true);
+    print_info_aligned("Building with semantics for surfaces", tally[bf_sem(lod)], true);
+    static const char* surfaces[SURFACE_TYPES] = {
+      "RoofSurface", "WallSurface", "GroundSurface", "ClosureSurface", "OuterCeilingSurface", "OuterFloorSurface"
+    };
+    for (int i = 0; i < SURFACE_TYPES; i++) {
+      if (stats.surfaces[i][lod] == 0)
+        continue;
+      print_info_aligned(surfaces[i], stats.surfaces[i][lod], true);
+      print_info_aligned("    gml:Polygon", stats.surface_polygons[i][lod], true);
+    }
   }
 
   //-- Terrain Intersection Curve
   std::cout << "Terrain Intersection Curve" << std::endl;
   for (int lod = 1; lod <= 4; lod++) {
-    int tic = 0;
-    s = "//" + ns["building"] + "Building";
-    nb = doc.select_nodes(s.c_str());
-    std::string slod = "lod" + std::to_string(lod);
-    for (auto& b : nb) {
-      std::string s1 = ".//" + ns["building"] + slod + "TerrainIntersection";
-      pugi::xpath_node_set tmp = b.node().select_nodes(s1.c_str());
-      if (tmp.empty() == false) {
-        for (auto& nbp : tmp) {
-          tic++;
-          break;
-        }
-      }
-    }
-    std::string tmp = "Building with " + slod + " TIC";
-    print_info_aligned(tmp, tic, true);
+    std::string tmp = "Building with lod" + std::to_string(lod) + " TIC";
+    print_info_aligned(tmp, tally[bf_tic(lod)], true);
   }
 
+  //-- openings, installations and interior (LOD3 and LOD4)
+  static const char* details[] = {
+    "Door", "Window", "BuildingInstallation", "IntBuildingInstallation", "Room", "BuildingFurniture"
+  };
+  for (int i = 0; i <= TAG_BUILDINGFURNITURE - TAG_DOOR; i++) {
+    print_info_aligned(details[i], stats.tags[TAG_DOOR + i]);
+    print_info_aligned("Building having one", tally[BF_DOOR + i], true);
+  }
+  print_sketch_aligned("Openings per WallSurface", stats.wall_openings);
   std::cout << std::endl;
 }
 
 
-void report_relief(pugi::xml_document& doc, std::map<std::string, std::string>& ns) {
+void print_relief(const Stats& stats) {
   std::cout << "+++++++++++++++++++++ RELIEF +++++++++++++++++++++" << std::endl;
-  std::string s;
-  int no;
+  print_info_aligned("ReliefFeature", stats.tags[TAG_RELIEFFEATURE]);
+  print_info_aligned("reliefComponent", stats.relief_component);
+  print_info_aligned("TINRelief", stats.tags[TAG_TINRELIEF]);
+  print_info_aligned("RasterRelief", stats.tags[TAG_RASTERRELIEF]);
+  print_info_aligned("MassPointRelief", stats.tags[TAG_MASSPOINTRELIEF]);
+  print_info_aligned("BreaklineRelief", stats.tags[TAG_BREAKLINERELIEF]);
+  print_info_aligned("# gml:Triangle", stats.tags[TAG_TRIANGLE]);
+  std::cout << std::endl;
+}
 
-  s = "//" + ns["dem"] + "ReliefFeature";
-  int nof = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("ReliefFeature", nof);
 
-  s = "//" + ns["dem"] + "ReliefFeature" + "/" + ns["dem"] + "reliefComponent";
-  int noc = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("reliefComponent", noc);
+void print_landuse(const Stats& stats) {
+  std::cout << "+++++++++++++++++++++ LANDUSE ++++++++++++++++++++" << std::endl;
+  print_info_aligned("LandUse", stats.tags[TAG_LANDUSE]);
+  std::cout << std::endl;
+}
 
-  s = "//" + ns["dem"] + "TINRelief";
-  no = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("TINRelief", no);
 
-  s = "//" + ns["dem"] + "RasterRelief";
-  no = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("RasterRelief", no);
+//-- per LOD, the objects of kind k having geometry in it
+static void print_lods_aligned(const Stats& stats, int lowest, const char* name, int k) {
+  for (int lod = lowest; lod <= 4; lod++)
+    print_info_aligned(std::string(name) + " with LOD" + std::to_string(lod), stats.feature_lods[k][LA_GEOMETRY][lod], true);
+}
 
-  s = "//" + ns["dem"] + "MassPointRelief";
-  no = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("MassPointRelief", no);
 
-  s = "//" + ns["dem"] + "BreaklineRelief";
-  no = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("BreaklineRelief", no);
+void print_water(const Stats& stats) {
+  std::cout << "++++++++++++++++++++++ WATER +++++++++++++++++++++" << std::endl;
+  print_info_aligned("WaterBody", stats.tags[TAG_WATERBODY]);
+  print_lods_aligned(stats, 0, "WaterBody", FK_WATERBODY);
+  print_info_aligned("WaterSurface", stats.tags[TAG_WATERSURFACE]);
+  print_info_aligned("WaterGroundSurface", stats.tags[TAG_WATERGROUNDSURFACE]);
+  print_info_aligned("WaterClosureSurface", stats.tags[TAG_WATERCLOSURESURFACE]);
+  std::cout << std::endl;
+}
 
-  s = "//" + ns["gml"] + "Triangle";
-  no = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("# gml:Triangle", no);
 
- 
+void print_vegetation(const Stats& stats) {
+  std::cout << "+++++++++++++++++++ VEGETATION +++++++++++++++++++" << std::endl;
+  print_info_aligned("SolitaryVegetationObject", stats.tags[TAG_SOLITARYVEGETATIONOBJECT]);
+  print_lods_aligned(stats, 1, "SVO", FK_SOLITARYVEGETATIONOBJECT);
+  print_info_aligned("with ImplicitGeometry", stats.feature_implicit[FK_SOLITARYVEGETATIONOBJECT], true);
+  print_info_aligned("PlantCover", stats.tags[TAG_PLANTCOVER]);
+  print_lods_aligned(stats, 1, "PlantCover", FK_PLANTCOVER);
+  //-- an implicit geometry is a prototype placed many times: given once
+  //-- (inline) and then referenced by xlink:href
+  print_info_aligned("ImplicitGeometry", stats.tags[TAG_IMPLICITGEOMETRY]);
+  print_info_aligned("with inline geometry", stats.implicit_inline, true);
+  print_info_aligned("with referenced geometry", stats.implicit_referenced, true);
+  print_info_aligned("prototypes referenced", stats.prototypes, true);
+  print_info_aligned("with libraryObject", stats.tags[TAG_LIBRARYOBJECT], true);
   std::cout << std::endl;
 }
 
 
-void report_landuse(pugi::xml_document& doc, std::map<std::string, std::string>& ns) {
-  std::cout << "+++++++++++++++++++++ LANDUSE ++++++++++++++++++++" << std::endl;
- 
-  std::string s = "//" + ns["luse"] + "LandUse";
-  int nof = doc.select_nodes(s.c_str()).size();
-  print_info_aligned("LandUse", nof);
+void print_transportation(const Stats& stats) {
+  std::cout << "+++++++++++++++++ TRANSPORTATION +++++++++++++++++" << std::endl;
+  print_info_aligned("TransportationComplex", stats.tags[TAG_TRANSPORTATIONCOMPLEX]);
+  print_info_aligned("Road", stats.tags[TAG_ROAD]);
+  print_info_aligned("Track", stats.tags[TAG_TRACK]);
+  print_info_aligned("Railway", stats.tags[TAG_RAILWAY]);
+  print_info_aligned("Square", stats.tags[TAG_SQUARE]);
+  print_lods_aligned(stats, 0, "Transportation", FK_TRANSPORTATION);
+  print_info_aligned("TrafficArea", stats.tags[TAG_TRAFFICAREA]);
+  print_lods_aligned(stats, 2, "TrafficArea", FK_TRAFFICAREA);
+  print_info_aligned("AuxiliaryTrafficArea", stats.tags[TAG_AUXILIARYTRAFFICAREA]);
+  print_lods_aligned(stats, 2, "AuxiliaryTrafficArea", FK_AUXILIARYTRAFFICAREA);
+  std::cout << std::endl;
+}
+
 
+//-- a Bridge or a Tunnel and its parts, like the buildings
+static void print_structure(const Stats& stats, const std::string& name, Tag t, int k,
+                            const std::string& part, Tag pt, int pk) {
+  print_info_aligned(name, stats.tags[t]);
+  print_info_aligned("without " + part, stats.tags[t] - stats.feature_with_parts[k], true);
+  print_info_aligned("having " + part, stats.feature_with_parts[k], true);
+  print_info_aligned("with gml:id", stats.feature_with_id[k], true);
+  print_info_aligned(part, stats.tags[pt]);
+  print_info_aligned("with gml:id", stats.feature_with_id[pk], true);
+  for (int lod = 1; lod <= 4; lod++) {
+    std::cout << "LOD" << lod << std::endl;
+    for (int i = 0; i < 2; i++) {
+      const std::string& n = (i == 0) ? name : part;
+      const size_t (&lods)[LA_COUNT][5] = stats.feature_lods[(i == 0) ? k : pk];
+      print_info_aligned(n + " with geometry", lods[LA_GEOMETRY][lod], true);
+      print_info_aligned("    stored in gml:Solid", lods[LA_SOLID][lod], true);
+      print_info_aligned("    stored in gml:MultiSurface", lods[LA_MULTISURFACE][lod], true);
+      print_info_aligned("    with semantics for surfaces", lods[LA_SEMANTICS][lod], true);
+    }
+  }
+  std::cout << "Terrain Intersection Curve" << std::endl;
+  for (int lod = 1; lod <= 4; lod++) {
+    print_info_aligned(name + " with lod" + std::to_string(lod) + " TIC", stats.feature_lods[k][LA_TIC][lod], true);
+    print_info_aligned(part + " with lod" + std::to_string(lod) + " TIC", stats.feature_lods[pk][LA_TIC][lod], true);
+  }
+}
+
+
+void print_bridge(const Stats& stats) {
+  std::cout << "+++++++++++++++++++++ BRIDGES ++++++++++++++++++++" << std::endl;
+  print_structure(stats, "Bridge", TAG_BRIDGE, FK_BRIDGE, "BridgePart", TAG_BRIDGEPART, FK_BRIDGEPART);
+  print_info_aligned("BridgeConstructionElement", stats.tags[TAG_BRIDGECONSTRUCTIONELEMENT]);
+  print_info_aligned("BridgeInstallation", stats.tags[TAG_BRIDGEINSTALLATION]);
+  print_info_aligned("IntBridgeInstallation", stats.tags[TAG_INTBRIDGEINSTALLATION]);
+  print_info_aligned("BridgeRoom", stats.tags[TAG_BRIDGEROOM]);
+  std::cout << std::endl;
+}
+
+
+void print_tunnel(const Stats& stats) {
+  std::cout << "+++++++++++++++++++++ TUNNELS ++++++++++++++++++++" << std::endl;
+  print_structure(stats, "Tunnel", TAG_TUNNEL, FK_TUNNEL, "TunnelPart", TAG_TUNNELPART, FK_TUNNELPART);
+  print_info_aligned("TunnelInstallation", stats.tags[TAG_TUNNELINSTALLATION]);
+  print_info_aligned("IntTunnelInstallation", stats.tags[TAG_INTTUNNELINSTALLATION]);
+  print_info_aligned("HollowSpace", stats.tags[TAG_HOLLOWSPACE]);
+  std::cout << std::endl;
+}
+
+
+void print_cityfurniture(const Stats& stats) {
+  std::cout << "+++++++++++++++++ CITYFURNITURE ++++++++++++++++++" << std::endl;
+  print_info_aligned("CityFurniture", stats.tags[TAG_CITYFURNITURE]);
+  print_info_aligned("with gml:id", stats.feature_with_id[FK_CITYFURNITURE], true);
+  print_lods_aligned(stats, 1, "CityFurniture", FK_CITYFURNITURE);
+  print_info_aligned("with ImplicitGeometry", stats.feature_implicit[FK_CITYFURNITURE], true);
+  for (int lod = 1; lod <= 4; lod++)
+    print_info_aligned("with lod" + std::to_string(lod) + " TIC", stats.feature_lods[FK_CITYFURNITURE][LA_TIC][lod], true);
+  std::cout << std::endl;
+}
+
+
+void print_group(const Stats& stats) {
+  std::cout << "++++++++++++++++ CITYOBJECTGROUP +++++++++++++++++" << std::endl;
+  print_info_aligned("CityObjectGroup", stats.tags[TAG_CITYOBJECTGROUP]);
+  print_info_aligned("with parent", stats.tags[TAG_GROUPPARENT], true);
+  print_info_aligned("groupMember", stats.tags[TAG_GROUPMEMBER]);
+  print_info_aligned("inline", stats.member_inline, true);
+  print_info_aligned("by xlink:href", stats.member_referenced, true);
+  print_info_aligned("    resolved", stats.member_resolved, true);
+  print_info_aligned("    unresolved", stats.member_referenced - stats.member_resolved, true);
   std::cout << std::endl;
 }
 
 
+void print_extent(const Stats& stats) {
+  static const char* classes[EC_COUNT] = { "Building", "Relief", "LandUse", "Water", "Vegetation", "Transportation" };
+  std::cout << "+++++++++++++++++++++ EXTENT +++++++++++++++++++++" << std::endl;
+  print_box_aligned("Declared (gml:Envelope)", stats.declared);
+  print_box_aligned("Dataset", stats.extent);
+  for (int i = 0; i < EC_COUNT; i++) {
+    if (stats.class_extent[i].empty() == false)
+      print_box_aligned(classes[i], stats.class_extent[i]);
+  }
+  if ( (stats.declared.empty() == false) && (stats.extent.empty() == false) ) {
+    bool inside = stats.declared.contains(stats.extent);
+    std::cout << std::setw(40) << std::left << "Declared envelope contains the dataset"
+              << std::setw(10) << std::right << (inside ? "yes" : "no") << std::endl;
+  }
+  std::cout << std::endl;
+}
+
+
+void print_geometry(const Stats& stats) {
+  std::cout << "++++++++++++++++++++ GEOMETRY ++++++++++++++++++++" << std::endl;
+  for (int lod = 1; lod <= 4; lod++) {
+    std::cout << "LOD" << lod << std::endl;
+    static const char* names[2] = { "volume", "area" };
+    for (int i = 0; i < 2; i++) {
+      const Measure& m = (i == 0) ? stats.building_volume[lod] : stats.building_area[lod];
+      print_info_aligned(std::string("Building with ") + ((i == 0) ? "a " : "an ") + names[i], m.values.count(), true);
+      if (m.values.count() == 0)
+        continue;
+      print_real_aligned(std::string("    ") + names[i] + " min", m.values.min(), true);
+      print_real_aligned(std::string("    ") + names[i] + " median", m.values.quantile(0.5), true);
+      print_real_aligned(std::string("    ") + names[i] + " max", m.values.max(), true);
+      print_real_aligned(std::string("    ") + names[i] + " sum", m.sum.value(), true);
+    }
+  }
+  std::cout << std::endl;
+}
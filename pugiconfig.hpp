@@ -26,6 +26,9 @@
 // Uncomment this to disable exceptions
 // #define PUGIXML_NO_EXCEPTIONS
 
+// Uncomment this to disable the SSE2/AVX2 scanning of text while parsing
+// #define PUGIXML_NO_SIMD
+
 // Set this to control attributes for public classes/functions, i.e.:
 // #define PUGIXML_API __declspec(dllexport) // to export all public symbols from DLL
 // #define PUGIXML_CLASS __declspec(dllimport) // to import all classes from DLL
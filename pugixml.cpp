@@ -42,6 +42,11 @@
 // For placement new
 #include <new>
 
+#if !defined(PUGIXML_NO_SIMD) && !defined(PUGIXML_WCHAR_MODE) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#	define PUGI__SIMD_X86
+#	include <immintrin.h>
+#endif
+
 #ifdef _MSC_VER
 #	pragma warning(push)
 #	pragma warning(disable: 4127) // conditional expression is constant
@@ -142,6 +147,7 @@ PUGI__NS_BEGIN
 	typedef unsigned __int8 uint8_t;
 	typedef unsigned __int16 uint16_t;
 	typedef unsigned __int32 uint32_t;
+	typedef unsigned __int64 uint64_t;
 PUGI__NS_END
 #endif
 
@@ -546,15 +552,26 @@ PUGI__NS_BEGIN
 		xml_extra_buffer* next;
 	};
 
+	struct xml_element_index;
+	struct xml_string_atoms;
+
 	struct xml_document_struct: public xml_node_struct, public xml_allocator
 	{
-		xml_document_struct(xml_memory_page* page): xml_node_struct(page, node_document), xml_allocator(page), buffer(0), extra_buffers(0)
+		xml_document_struct(xml_memory_page* page): xml_node_struct(page, node_document), xml_allocator(page), buffer(0), extra_buffers(0), element_index(0), atoms(0), value_atoms(0), filter(0), options(0)
 		{
 		}
 
 		const char_t* buffer;
 
 		xml_extra_buffer* extra_buffers;
+
+		xml_element_index* element_index;
+
+		xml_string_atoms* atoms;
+		xml_string_atoms* value_atoms;
+
+		xml_parse_filter* filter;
+		unsigned int options; // of the last parse, for xml_node::expand
 	};
 
 	inline xml_allocator& get_allocator(const xml_node_struct* node)
@@ -572,6 +589,516 @@ PUGI__NS_BEGIN
 	}
 PUGI__NS_END
 
+// Element index
+PUGI__NS_BEGIN
+	// Elements of a document grouped by name, each group in document order, and the preorder
+	// numbers of all the nodes of the document (see xml_document::build_element_index)
+	struct xml_element_index
+	{
+		struct entry
+		{
+			const char_t* name;
+			unsigned int hash;
+			xml_node_struct** nodes;
+			size_t size;
+		};
+
+		struct label
+		{
+			xml_node_struct* node;
+			unsigned int pre;
+		};
+
+		entry* entries; // open addressing, capacity is a power of two
+		size_t capacity;
+		size_t used;
+
+		xml_node_struct** nodes;
+
+		label* labels; // open addressing on the node address, capacity is a power of two
+		size_t label_capacity;
+
+		size_t memory;
+	};
+
+	PUGI__FN unsigned int element_index_hash(const char_t* name)
+	{
+		// FNV-1a
+		unsigned int result = 2166136261u;
+
+		while (*name)
+			result = (result ^ static_cast<unsigned int>(*name++)) * 16777619u;
+
+		return result;
+	}
+
+	PUGI__FN xml_element_index::entry* element_index_slot(xml_element_index::entry* entries, size_t capacity, const char_t* name, unsigned int hash)
+	{
+		size_t bucket = hash & (capacity - 1);
+
+		for (size_t probe = 0; probe < capacity; ++probe)
+		{
+			xml_element_index::entry* e = entries + bucket;
+
+			if (!e->name || (e->hash == hash && strequal(e->name, name))) return e;
+
+			bucket = (bucket + probe + 1) & (capacity - 1);
+		}
+
+		assert(!"Element index is full");
+		return 0;
+	}
+
+	PUGI__FN const xml_element_index::entry* element_index_find(const xml_element_index* index, const char_t* name)
+	{
+		const xml_element_index::entry* e = element_index_slot(index->entries, index->capacity, name, element_index_hash(name));
+
+		return e->name ? e : 0;
+	}
+
+	PUGI__FN bool element_index_grow(xml_element_index* index)
+	{
+		size_t capacity = index->capacity * 2;
+
+		xml_element_index::entry* entries = static_cast<xml_element_index::entry*>(xml_memory::allocate(capacity * sizeof(xml_element_index::entry)));
+		if (!entries) return false;
+
+		memset(entries, 0, capacity * sizeof(xml_element_index::entry));
+
+		for (size_t i = 0; i < index->capacity; ++i)
+			if (index->entries[i].name)
+				*element_index_slot(entries, capacity, index->entries[i].name, index->entries[i].hash) = index->entries[i];
+
+		xml_memory::deallocate(index->entries);
+
+		index->entries = entries;
+		index->capacity = capacity;
+
+		return true;
+	}
+
+	PUGI__FN void element_index_destroy(xml_element_index* index)
+	{
+		if (index->entries) xml_memory::deallocate(index->entries);
+		if (index->nodes) xml_memory::deallocate(index->nodes);
+		if (index->labels) xml_memory::deallocate(index->labels);
+
+		xml_memory::deallocate(index);
+	}
+
+	// Node after cur in preorder among root and its descendants, 0 at the end
+	PUGI__FN xml_node_struct* next_preorder(xml_node_struct* cur, xml_node_struct* root)
+	{
+		if (cur->first_child) return cur->first_child;
+
+		while (cur != root && !cur->next_sibling) cur = cur->parent;
+
+		return cur == root ? 0 : cur->next_sibling;
+	}
+
+	PUGI__FN xml_element_index::label* element_index_label_slot(xml_element_index::label* labels, size_t capacity, const xml_node_struct* node)
+	{
+		size_t bucket = static_cast<size_t>((reinterpret_cast<uintptr_t>(node) / sizeof(void*)) * 2654435761u) & (capacity - 1);
+
+		while (labels[bucket].node && labels[bucket].node != node)
+			bucket = (bucket + 1) & (capacity - 1);
+
+		return labels + bucket;
+	}
+
+	PUGI__FN const xml_element_index::label* element_index_label(const xml_element_index* index, const xml_node_struct* node)
+	{
+		if (!index->labels) return 0;
+
+		const xml_element_index::label* l = element_index_label_slot(index->labels, index->label_capacity, node);
+
+		return l->node ? l : 0;
+	}
+
+	// Numbers root and all the nodes below it in preorder, which is document order
+	PUGI__FN bool element_index_label_nodes(xml_element_index* index, xml_node_struct* root)
+	{
+		size_t count = 1;
+
+		for (xml_node_struct* cur = root->first_child; cur; cur = next_preorder(cur, root))
+			++count;
+
+		// the numbers are 32-bit; such a document simply gets no labels
+		if (count >= 0x7fffffffu) return true;
+
+		size_t capacity = 64;
+		while (capacity < count * 2) capacity *= 2;
+
+		xml_element_index::label* labels = static_cast<xml_element_index::label*>(xml_memory::allocate(capacity * sizeof(xml_element_index::label)));
+		if (!labels) return false;
+
+		memset(labels, 0, capacity * sizeof(xml_element_index::label));
+
+		unsigned int pre = 0;
+
+		for (xml_node_struct* cur = root; cur; cur = next_preorder(cur, root))
+		{
+			xml_element_index::label* l = element_index_label_slot(labels, capacity, cur);
+			l->node = cur;
+			l->pre = pre++;
+		}
+
+		index->labels = labels;
+		index->label_capacity = capacity;
+
+		return true;
+	}
+
+	// Preorder traversal of the elements below root
+	template <typename F> void element_index_visit(xml_node_struct* root, F& f)
+	{
+		xml_node_struct* cur = root->first_child;
+
+		while (cur)
+		{
+			if (PUGI__NODETYPE(cur) == node_element) f(cur);
+
+			if (cur->first_child)
+				cur = cur->first_child;
+			else
+			{
+				while (!cur->next_sibling)
+				{
+					cur = cur->parent;
+
+					if (cur == root) return;
+				}
+
+				cur = cur->next_sibling;
+			}
+		}
+	}
+
+	struct element_index_counter
+	{
+		xml_element_index* index;
+		size_t total;
+		bool oom;
+
+		void operator()(xml_node_struct* n)
+		{
+			const char_t* name = n->name ? n->name : PUGIXML_TEXT("");
+			unsigned int hash = element_index_hash(name);
+
+			// keep the load factor under 1/2
+			if ((index->used + 1) * 2 > index->capacity && !element_index_grow(index))
+			{
+				oom = true;
+				return;
+			}
+
+			xml_element_index::entry* e = element_index_slot(index->entries, index->capacity, name, hash);
+
+			if (!e->name)
+			{
+				e->name = name;
+				e->hash = hash;
+				index->used++;
+			}
+
+			e->size++;
+			total++;
+		}
+	};
+
+	struct element_index_filler
+	{
+		xml_element_index* index;
+
+		void operator()(xml_node_struct* n)
+		{
+			const char_t* name = n->name ? n->name : PUGIXML_TEXT("");
+			xml_element_index::entry* e = element_index_slot(index->entries, index->capacity, name, element_index_hash(name));
+
+			e->nodes[e->size++] = n;
+		}
+	};
+
+	PUGI__FN xml_element_index* element_index_build(xml_node_struct* root)
+	{
+		xml_element_index* index = static_cast<xml_element_index*>(xml_memory::allocate(sizeof(xml_element_index)));
+		if (!index) return 0;
+
+		index->capacity = 64;
+		index->used = 0;
+		index->nodes = 0;
+		index->labels = 0;
+		index->label_capacity = 0;
+		index->entries = static_cast<xml_element_index::entry*>(xml_memory::allocate(index->capacity * sizeof(xml_element_index::entry)));
+
+		if (!index->entries)
+		{
+			element_index_destroy(index);
+			return 0;
+		}
+
+		memset(index->entries, 0, index->capacity * sizeof(xml_element_index::entry));
+
+		// first pass: number of elements of each name
+		element_index_counter counter = {index, 0, false};
+		element_index_visit(root, counter);
+
+		if (counter.oom)
+		{
+			element_index_destroy(index);
+			return 0;
+		}
+
+		index->nodes = static_cast<xml_node_struct**>(xml_memory::allocate((counter.total ? counter.total : 1) * sizeof(xml_node_struct*)));
+
+		if (!index->nodes)
+		{
+			element_index_destroy(index);
+			return 0;
+		}
+
+		// each name gets a slice of the node array
+		xml_node_struct** slice = index->nodes;
+
+		for (size_t i = 0; i < index->capacity; ++i)
+		{
+			xml_element_index::entry& e = index->entries[i];
+
+			if (!e.name) continue;
+
+			e.nodes = slice;
+			slice += e.size;
+			e.size = 0;
+		}
+
+		// second pass: the elements, in document order
+		element_index_filler filler = {index};
+		element_index_visit(root, filler);
+
+		// the positions in the buffer already give the document order, unless nodes were moved or several buffers were parsed
+		if ((get_document(root).header & xml_memory_page_contents_shared_mask) && !element_index_label_nodes(index, root))
+		{
+			element_index_destroy(index);
+			return 0;
+		}
+
+		index->memory = sizeof(xml_element_index) + index->capacity * sizeof(xml_element_index::entry) + counter.total * sizeof(xml_node_struct*) +
+			index->label_capacity * sizeof(xml_element_index::label);
+
+		return index;
+	}
+
+PUGI__NS_END
+
+// String atoms
+PUGI__NS_BEGIN
+	// Strings of a document interned with parse_intern_names (element and attribute names) or parse_intern_values
+	// (short attribute and text values): each string points to the first occurrence of its text in the document,
+	// so that equal strings are equal pointers
+	struct xml_string_atoms
+	{
+		struct entry
+		{
+			const char_t* atom;
+			unsigned int hash;
+		};
+
+		entry* entries; // open addressing, capacity is a power of two
+		size_t capacity;
+		size_t used;
+		size_t table_bytes; // largest size of the table
+
+		size_t strings; // strings pointing to an atom
+		size_t distinct; // atoms, including those of a released table
+		size_t string_bytes; // bytes of these strings
+		size_t atom_bytes; // bytes of the distinct strings
+
+		bool complete; // false once a string is added or changed without being interned
+	};
+
+	// Values longer than this (coordinate lists, long texts) are hardly ever repeated and are not worth hashing
+	static const size_t xml_value_atom_max_length = 64;
+
+	PUGI__FN xml_string_atoms::entry* string_atoms_slot(xml_string_atoms::entry* entries, size_t capacity, const char_t* string, unsigned int hash)
+	{
+		size_t bucket = hash & (capacity - 1);
+
+		while (entries[bucket].atom && (entries[bucket].hash != hash || !strequal(entries[bucket].atom, string)))
+			bucket = (bucket + 1) & (capacity - 1);
+
+		return entries + bucket;
+	}
+
+	PUGI__FN const char_t* string_atoms_find(const xml_string_atoms* atoms, const char_t* string)
+	{
+		return string_atoms_slot(atoms->entries, atoms->capacity, string, element_index_hash(string))->atom;
+	}
+
+	PUGI__FN bool string_atoms_grow(xml_string_atoms* atoms)
+	{
+		size_t capacity = atoms->capacity ? atoms->capacity * 2 : 256;
+
+		xml_string_atoms::entry* entries = static_cast<xml_string_atoms::entry*>(xml_memory::allocate(capacity * sizeof(xml_string_atoms::entry)));
+		if (!entries) return false;
+
+		memset(entries, 0, capacity * sizeof(xml_string_atoms::entry));
+
+		for (size_t i = 0; i < atoms->capacity; ++i)
+			if (atoms->entries[i].atom)
+				*string_atoms_slot(entries, capacity, atoms->entries[i].atom, atoms->entries[i].hash) = atoms->entries[i];
+
+		if (atoms->entries) xml_memory::deallocate(atoms->entries);
+
+		atoms->entries = entries;
+		atoms->capacity = capacity;
+
+		size_t table_bytes = sizeof(xml_string_atoms) + capacity * sizeof(xml_string_atoms::entry);
+		if (atoms->table_bytes < table_bytes) atoms->table_bytes = table_bytes;
+
+		return true;
+	}
+
+	PUGI__FN xml_string_atoms* string_atoms_create(xml_string_atoms*& atoms)
+	{
+		if (!atoms)
+		{
+			atoms = static_cast<xml_string_atoms*>(xml_memory::allocate(sizeof(xml_string_atoms)));
+			if (!atoms) return 0;
+
+			memset(atoms, 0, sizeof(xml_string_atoms));
+		}
+
+		return atoms;
+	}
+
+	// Drops the table but keeps the statistics; strings interned afterwards are not shared with the earlier ones
+	PUGI__FN void string_atoms_release(xml_string_atoms* atoms)
+	{
+		if (atoms->entries) xml_memory::deallocate(atoms->entries);
+
+		atoms->entries = 0;
+		atoms->capacity = 0;
+		atoms->used = 0;
+	}
+
+	PUGI__FN void string_atoms_destroy(xml_string_atoms* atoms)
+	{
+		if (atoms->entries) xml_memory::deallocate(atoms->entries);
+
+		xml_memory::deallocate(atoms);
+	}
+
+	// Points the string to its atom; strings that are not in the buffer of the document (allocated, or shared with
+	// another node by a copy) are left alone, and the atoms are then incomplete
+	PUGI__FN bool string_atoms_intern(xml_string_atoms* atoms, char_t*& string, uintptr_t& header, bool in_buffer, size_t max_length)
+	{
+		if (!string) return true;
+
+		size_t length = 0;
+
+		while (string[length] && length <= max_length) ++length;
+
+		if (length > max_length) return true;
+
+		unsigned int hash = element_index_hash(string);
+
+		if ((atoms->used + 1) * 2 > atoms->capacity && !string_atoms_grow(atoms)) return false;
+
+		xml_string_atoms::entry* e = string_atoms_slot(atoms->entries, atoms->capacity, string, hash);
+
+		if (!in_buffer)
+		{
+			// already interned by an earlier parse into this document
+			if (string != e->atom) atoms->complete = false;
+
+			return true;
+		}
+
+		size_t bytes = (length + 1) * sizeof(char_t);
+
+		if (!e->atom)
+		{
+			e->atom = string;
+			e->hash = hash;
+			atoms->used++;
+			atoms->distinct++;
+			atoms->atom_bytes += bytes;
+		}
+
+		atoms->strings++;
+		atoms->string_bytes += bytes;
+
+		// the atom is shared by all the nodes with this string, so it must never be written to in place
+		string = const_cast<char_t*>(e->atom);
+		header |= xml_memory_page_contents_shared_mask;
+
+		return true;
+	}
+
+	// Interns the strings of the subtree of root (the whole document after a load, the children of an element after
+	// xml_node::expand)
+	PUGI__FN bool intern_strings(xml_document_struct* doc, xml_node_struct* root, unsigned int optmsk)
+	{
+		xml_string_atoms* names = (optmsk & parse_intern_names) ? string_atoms_create(doc->atoms) : 0;
+		if ((optmsk & parse_intern_names) && !names) return false;
+
+		xml_string_atoms* values = (optmsk & parse_intern_values) ? string_atoms_create(doc->value_atoms) : 0;
+		if ((optmsk & parse_intern_values) && !values) return false;
+
+		if (names && root == doc) names->complete = true;
+
+		const uintptr_t name_moved = xml_memory_page_name_allocated_mask | xml_memory_page_contents_shared_mask;
+		const uintptr_t value_moved = xml_memory_page_value_allocated_mask | xml_memory_page_contents_shared_mask;
+		const size_t any_length = ~static_cast<size_t>(0);
+
+		for (xml_node_struct* cur = root->first_child; cur; cur = next_preorder(cur, root))
+		{
+			xml_node_type type = PUGI__NODETYPE(cur);
+
+			if (type == node_element)
+			{
+				if (names && !string_atoms_intern(names, cur->name, cur->header, !(cur->header & name_moved), any_length)) return false;
+
+				for (xml_attribute_struct* a = cur->first_attribute; a; a = a->next_attribute)
+				{
+					// the name and the value share the header flag, so both are tested before either is interned
+					uintptr_t header = a->header;
+
+					if (names && !string_atoms_intern(names, a->name, a->header, !(header & name_moved), any_length)) return false;
+					if (values && !string_atoms_intern(values, a->value, a->header, !(header & value_moved), xml_value_atom_max_length)) return false;
+				}
+			}
+			else if (values && (type == node_pcdata || type == node_cdata))
+			{
+				if (!string_atoms_intern(values, cur->value, cur->header, !(cur->header & value_moved), xml_value_atom_max_length)) return false;
+			}
+		}
+
+		// unlike the names, the values are never looked up once the document is loaded
+		if (values) string_atoms_release(values);
+
+		// strings no longer point into the buffer, so the buffer positions do not give the document order
+		doc->header |= xml_memory_page_contents_shared_mask;
+
+		return true;
+	}
+
+	// The index and the atoms do not follow changes to the document: any change drops the index,
+	// and name tests stop relying on the atoms
+	template <typename Object> void document_changed(const Object* object)
+	{
+		xml_document_struct& doc = get_document(object);
+
+		if (doc.element_index)
+		{
+			element_index_destroy(doc.element_index);
+			doc.element_index = 0;
+		}
+
+		if (doc.atoms) doc.atoms->complete = false;
+	}
+PUGI__NS_END
+
 // Low-level DOM operations
 PUGI__NS_BEGIN
 	inline xml_attribute_struct* allocate_attribute(xml_allocator& alloc)
@@ -1318,6 +1845,65 @@ PUGI__NS_BEGIN
 		return encoding_utf8;
 	}
 
+	// Finds the value of the encoding pseudo-attribute in the XML declaration at the start of data, if any
+	PUGI__FN bool parse_declaration_encoding(const uint8_t* data, size_t size, const uint8_t*& out_encoding, size_t& out_length)
+	{
+	#define PUGI__SCANCHAR(ch) { if (offset >= size || data[offset] != ch) return false; offset++; }
+	#define PUGI__SCANCHARTYPE(ct) { while (offset < size && PUGI__IS_CHARTYPE(data[offset], ct)) offset++; }
+
+		if (size < 6 || memcmp(data, "<?xml", 5) != 0 || !PUGI__IS_CHARTYPE(data[5], ct_space))
+			return false;
+
+		for (size_t i = 6; i + 1 < size; ++i)
+		{
+			// the declaration ends here, without encoding
+			if (data[i] == '?')
+				return false;
+
+			// the version that comes first can not contain 'en'
+			if (data[i] == 'e' && data[i + 1] == 'n')
+			{
+				size_t offset = i;
+
+				PUGI__SCANCHAR('e'); PUGI__SCANCHAR('n'); PUGI__SCANCHAR('c'); PUGI__SCANCHAR('o');
+				PUGI__SCANCHAR('d'); PUGI__SCANCHAR('i'); PUGI__SCANCHAR('n'); PUGI__SCANCHAR('g');
+
+				PUGI__SCANCHARTYPE(ct_space);
+				PUGI__SCANCHAR('=');
+				PUGI__SCANCHARTYPE(ct_space);
+
+				uint8_t delimiter = (offset < size && data[offset] == '"') ? '"' : '\'';
+				PUGI__SCANCHAR(delimiter);
+
+				size_t start = offset;
+				PUGI__SCANCHARTYPE(ct_symbol);
+
+				out_encoding = data + start;
+				out_length = offset - start;
+
+				PUGI__SCANCHAR(delimiter);
+
+				return true;
+			}
+		}
+
+		return false;
+
+	#undef PUGI__SCANCHARTYPE
+	#undef PUGI__SCANCHAR
+	}
+
+	PUGI__FN bool is_latin1_encoding_name(const uint8_t* name, size_t length)
+	{
+		const char* names[] = { "ISO-8859-1", "iso-8859-1", "ISO8859-1", "iso8859-1", "Latin1", "latin1", "LATIN1" };
+
+		for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+			if (strlen(names[i]) == length && memcmp(name, names[i], length) == 0)
+				return true;
+
+		return false;
+	}
+
 	PUGI__FN xml_encoding get_buffer_encoding(xml_encoding encoding, const void* contents, size_t size)
 	{
 		// replace wchar encoding with utf implementation
@@ -1340,7 +1926,16 @@ PUGI__NS_BEGIN
 
 		PUGI__DMC_VOLATILE uint8_t d0 = data[0], d1 = data[1], d2 = data[2], d3 = data[3];
 
-		return guess_buffer_encoding(d0, d1, d2, d3);
+		xml_encoding guess = guess_buffer_encoding(d0, d1, d2, d3);
+
+		// 8-bit documents may declare latin1 in the XML declaration
+		const uint8_t* name = 0;
+		size_t name_length = 0;
+
+		if (guess == encoding_utf8 && parse_declaration_encoding(data, size, name, name_length) && is_latin1_encoding_name(name, name_length))
+			return encoding_latin1;
+
+		return guess;
 	}
 
 	PUGI__FN bool get_mutable_buffer(char_t*& out_buffer, size_t& out_length, const void* contents, size_t size, bool is_mutable)
@@ -1507,7 +2102,7 @@ PUGI__NS_BEGIN
 		return true;
 	}
 
-	PUGI__FN bool convert_buffer(char_t*& out_buffer, size_t& out_length, xml_encoding encoding, const void* contents, size_t size, bool is_mutable)
+	PUGI__FN bool convert_buffer(char_t*& out_buffer, size_t& out_length, xml_encoding encoding, const void* contents, size_t size, bool is_mutable, bool /* keep_input */)
 	{
 		// get native encoding
 		xml_encoding wchar_encoding = get_wchar_encoding();
@@ -1548,27 +2143,124 @@ PUGI__NS_BEGIN
 		return false;
 	}
 #else
-	template <typename opt_swap> PUGI__FN bool convert_buffer_utf16(char_t*& out_buffer, size_t& out_length, const void* contents, size_t size, opt_swap)
+#ifdef PUGI__SIMD_X86
+	// Loads 8 utf16 units in native order; true if they are all ASCII
+	template <typename opt_swap> inline bool load_utf16_ascii8(const uint16_t* data, __m128i& units)
+	{
+		units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+		if (opt_swap::value) units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+
+		return _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xff80))), _mm_setzero_si128())) == 0xffff;
+	}
+#endif
+
+	// units of the character starting at data: a surrogate pair is decoded in one go
+	template <typename opt_swap> inline size_t get_utf16_char_units(const uint16_t* data, const uint16_t* end)
+	{
+		unsigned int lead = opt_swap::value ? endian_swap(*data) : *data;
+
+		return (static_cast<unsigned int>(lead - 0xD800) < 0x400 && data + 1 < end) ? 2 : 1;
+	}
+
+	// Length of utf16 input in utf8 units; fits tells if the output can be written over the input, i.e. if the output
+	// of every character ends before the input of the next one (always true below U+0800)
+	template <typename opt_swap> PUGI__FN size_t get_utf16_utf8_length(const uint16_t* data, size_t size, bool& fits)
+	{
+		const uint16_t* begin = data;
+		const uint16_t* end = data + size;
+		size_t length = 0;
+
+		fits = true;
+
+		while (data < end)
+		{
+		#ifdef PUGI__SIMD_X86
+			__m128i units;
+
+			if (end - data >= 8 && load_utf16_ascii8<opt_swap>(data, units))
+			{
+				data += 8;
+				length += 8;
+				continue;
+			}
+		#endif
+
+			size_t count = get_utf16_char_units<opt_swap>(data, end);
+
+			length += utf_decoder<utf8_counter, opt_swap>::decode_utf16_block(data, count, 0);
+			data += count;
+
+			if (length > static_cast<size_t>(data - begin) * sizeof(uint16_t)) fits = false;
+		}
+
+		return length;
+	}
+
+	// Same as decode_utf16_block with utf8_writer, with the runs of ASCII converted 8 units at a time
+	template <typename opt_swap> PUGI__FN uint8_t* convert_utf16_utf8(const uint16_t* data, size_t size, uint8_t* out)
+	{
+	#ifdef PUGI__SIMD_X86
+		const uint16_t* end = data + size;
+
+		while (data < end)
+		{
+			__m128i units;
+
+			if (end - data >= 8 && load_utf16_ascii8<opt_swap>(data, units))
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(units, units));
+				data += 8;
+				out += 8;
+				continue;
+			}
+
+			size_t count = get_utf16_char_units<opt_swap>(data, end);
+
+			out = utf_decoder<utf8_writer, opt_swap>::decode_utf16_block(data, count, out);
+			data += count;
+		}
+
+		return out;
+	#else
+		return utf_decoder<utf8_writer, opt_swap>::decode_utf16_block(data, size, out);
+	#endif
+	}
+
+	template <typename opt_swap> PUGI__FN bool convert_buffer_utf16(char_t*& out_buffer, size_t& out_length, const void* contents, size_t size, bool in_place, opt_swap)
 	{
 		const uint16_t* data = static_cast<const uint16_t*>(contents);
 		size_t data_length = size / sizeof(uint16_t);
 
+		// the parser skips the byte order mark anyway, and in utf8 it would take more room than the input
+		if (data_length > 0 && (opt_swap::value ? endian_swap(*data) : *data) == 0xfeff)
+		{
+			data++;
+			data_length--;
+		}
+
 		// first pass: get length in utf8 units
-		size_t length = utf_decoder<utf8_counter, opt_swap>::decode_utf16_block(data, data_length, 0);
+		bool fits;
+		size_t length = get_utf16_utf8_length<opt_swap>(data, data_length, fits);
 
-		// allocate buffer of suitable length
-		char_t* buffer = static_cast<char_t*>(xml_memory::allocate((length + 1) * sizeof(char_t)));
+		// convert over the input if it stays allocated anyway, otherwise allocate buffer of suitable length
+		char_t* buffer = (in_place && fits) ? static_cast<char_t*>(const_cast<void*>(contents)) : static_cast<char_t*>(xml_memory::allocate((length + 1) * sizeof(char_t)));
 		if (!buffer) return false;
 
 		// second pass: convert utf16 input to utf8
 		uint8_t* obegin = reinterpret_cast<uint8_t*>(buffer);
-		uint8_t* oend = utf_decoder<utf8_writer, opt_swap>::decode_utf16_block(data, data_length, obegin);
+		uint8_t* oend = convert_utf16_utf8<opt_swap>(data, data_length, obegin);
 
 		assert(oend == obegin + length);
-		*oend = 0;
 
 		out_buffer = buffer;
-		out_length = length + 1;
+		out_length = length;
+
+		// in place there may be no room left for the terminator, which the parser does without
+		if (buffer != contents || length < size)
+		{
+			*oend = 0;
+			out_length++;
+		}
 
 		return true;
 	}
@@ -1600,13 +2292,63 @@ PUGI__NS_BEGIN
 
 	PUGI__FN size_t get_latin1_7bit_prefix_length(const uint8_t* data, size_t size)
 	{
-		for (size_t i = 0; i < size; ++i)
+		size_t i = 0;
+
+	#ifdef PUGI__SIMD_X86
+		for (; i + 16 <= size; i += 16)
+		{
+			int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+			if (mask) return i + __builtin_ctz(mask);
+		}
+	#endif
+
+		for (; i < size; ++i)
 			if (data[i] > 127)
 				return i;
 
 		return size;
 	}
 
+	// Length of latin1 input in utf8 units: the characters above 127 take two
+	PUGI__FN size_t get_latin1_utf8_length(const uint8_t* data, size_t size)
+	{
+		size_t length = size;
+		size_t i = 0;
+
+	#ifdef PUGI__SIMD_X86
+		for (; i + 16 <= size; i += 16)
+			length += __builtin_popcount(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))));
+	#endif
+
+		for (; i < size; ++i)
+			length += data[i] >> 7;
+
+		return length;
+	}
+
+	// Same as decode_latin1_block with utf8_writer, with the runs of ASCII copied 16 characters at a time
+	PUGI__FN uint8_t* convert_latin1_utf8(const uint8_t* data, size_t size, uint8_t* out)
+	{
+		size_t i = 0;
+
+	#ifdef PUGI__SIMD_X86
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+			if (_mm_movemask_epi8(chars) == 0)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), chars);
+				out += 16;
+			}
+			else
+				out = utf_decoder<utf8_writer>::decode_latin1_block(data + i, 16, out);
+		}
+	#endif
+
+		return utf_decoder<utf8_writer>::decode_latin1_block(data + i, size - i, out);
+	}
+
 	PUGI__FN bool convert_buffer_latin1(char_t*& out_buffer, size_t& out_length, const void* contents, size_t size, bool is_mutable)
 	{
 		const uint8_t* data = static_cast<const uint8_t*>(contents);
@@ -1623,7 +2365,7 @@ PUGI__NS_BEGIN
 		if (postfix_length == 0) return get_mutable_buffer(out_buffer, out_length, contents, size, is_mutable);
 
 		// first pass: get length in utf8 units
-		size_t length = prefix_length + utf_decoder<utf8_counter>::decode_latin1_block(postfix, postfix_length, 0);
+		size_t length = prefix_length + get_latin1_utf8_length(postfix, postfix_length);
 
 		// allocate buffer of suitable length
 		char_t* buffer = static_cast<char_t*>(xml_memory::allocate((length + 1) * sizeof(char_t)));
@@ -1633,7 +2375,7 @@ PUGI__NS_BEGIN
 		memcpy(buffer, data, prefix_length);
 
 		uint8_t* obegin = reinterpret_cast<uint8_t*>(buffer);
-		uint8_t* oend = utf_decoder<utf8_writer>::decode_latin1_block(postfix, postfix_length, obegin + prefix_length);
+		uint8_t* oend = convert_latin1_utf8(postfix, postfix_length, obegin + prefix_length);
 
 		assert(oend == obegin + length);
 		*oend = 0;
@@ -1644,7 +2386,7 @@ PUGI__NS_BEGIN
 		return true;
 	}
 
-	PUGI__FN bool convert_buffer(char_t*& out_buffer, size_t& out_length, xml_encoding encoding, const void* contents, size_t size, bool is_mutable)
+	PUGI__FN bool convert_buffer(char_t*& out_buffer, size_t& out_length, xml_encoding encoding, const void* contents, size_t size, bool is_mutable, bool keep_input)
 	{
 		// fast path: no conversion required
 		if (encoding == encoding_utf8) return get_mutable_buffer(out_buffer, out_length, contents, size, is_mutable);
@@ -1655,8 +2397,8 @@ PUGI__NS_BEGIN
 			xml_encoding native_encoding = is_little_endian() ? encoding_utf16_le : encoding_utf16_be;
 
 			return (native_encoding == encoding) ?
-				convert_buffer_utf16(out_buffer, out_length, contents, size, opt_false()) :
-				convert_buffer_utf16(out_buffer, out_length, contents, size, opt_true());
+				convert_buffer_utf16(out_buffer, out_length, contents, size, is_mutable && keep_input, opt_false()) :
+				convert_buffer_utf16(out_buffer, out_length, contents, size, is_mutable && keep_input, opt_true());
 		}
 
 		// source encoding is utf32
@@ -1996,6 +2738,177 @@ PUGI__NS_BEGIN
 	#define PUGI__THROW_ERROR(err, m)   return error_offset = m, error_status = err, static_cast<char_t*>(0)
 	#define PUGI__CHECK_ERROR(err, m)   { if (*s == 0) PUGI__THROW_ERROR(err, m); }
 
+	// Characters a scan stops at
+	enum scan_set_t
+	{
+		scan_pcdata,	// \0, &, \r, < (ct_parse_pcdata)
+		scan_attr,		// \0, &, \r, ', " (ct_parse_attr)
+		scan_attr_ws,	// \0, &, \r, ', ", \n, tab (ct_parse_attr_ws)
+		scan_tag,		// \0, <
+		scan_nonspace,	// anything but \r, \n, space, tab (ct_space)
+		scan_set_count
+	};
+
+	template <int set> inline bool scan_stop(char_t c)
+	{
+		switch (set)
+		{
+		case scan_pcdata: return PUGI__IS_CHARTYPE(c, ct_parse_pcdata) != 0;
+		case scan_attr: return PUGI__IS_CHARTYPE(c, ct_parse_attr) != 0;
+		case scan_attr_ws: return PUGI__IS_CHARTYPE(c, ct_parse_attr_ws) != 0;
+		case scan_tag: return c == '<' || c == 0;
+		default: return !PUGI__IS_CHARTYPE(c, ct_space);
+		}
+	}
+
+	template <int set> PUGI__FN char_t* scan_scalar(char_t* s)
+	{
+		PUGI__SCANWHILE_UNROLL(!scan_stop<set>(ss));
+
+		return s;
+	}
+
+#ifdef PUGI__SIMD_X86
+	// The blocks are loaded aligned: an aligned load never crosses a page boundary, so reading past the terminating zero of
+	// the buffer is safe. The first block is shifted so that the characters before s are not matched.
+	#if defined(__has_feature)
+	#	if __has_feature(address_sanitizer)
+	#		define PUGI__SCAN_NO_SANITIZE __attribute__((no_sanitize_address))
+	#	endif
+	#elif defined(__SANITIZE_ADDRESS__)
+	#	define PUGI__SCAN_NO_SANITIZE __attribute__((no_sanitize_address))
+	#endif
+
+	#ifndef PUGI__SCAN_NO_SANITIZE
+	#	define PUGI__SCAN_NO_SANITIZE
+	#endif
+
+	#define PUGI__SCAN_MATCH(EQ, OR, ANDNOT, ONES) \
+		if (set == scan_nonspace) return ANDNOT(OR(OR(EQ(' '), EQ('\t')), OR(EQ('\r'), EQ('\n'))), ONES); \
+		m = OR(EQ(0), EQ(set == scan_tag || set == scan_pcdata ? '<' : '"')); \
+		if (set == scan_tag) return m; \
+		m = OR(m, OR(EQ('&'), EQ('\r'))); \
+		if (set == scan_pcdata) return m; \
+		m = OR(m, EQ('\'')); \
+		if (set == scan_attr) return m; \
+		return OR(m, OR(EQ('\n'), EQ('\t')))
+
+	#define PUGI__EQ_SSE2(c) _mm_cmpeq_epi8(v, _mm_set1_epi8(c))
+
+	template <int set> inline __m128i scan_match_sse2(__m128i v)
+	{
+		__m128i m;
+		PUGI__SCAN_MATCH(PUGI__EQ_SSE2, _mm_or_si128, _mm_andnot_si128, _mm_set1_epi8(-1));
+	}
+
+	template <int set> PUGI__FN PUGI__SCAN_NO_SANITIZE char_t* scan_sse2(char_t* s)
+	{
+		size_t offset = reinterpret_cast<uintptr_t>(s) & 15;
+		char_t* block = s - offset;
+
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(scan_match_sse2<set>(_mm_load_si128(reinterpret_cast<const __m128i*>(block))))) >> offset;
+		if (mask) return s + __builtin_ctz(mask);
+
+		while (true)
+		{
+			block += 16;
+
+			mask = static_cast<unsigned int>(_mm_movemask_epi8(scan_match_sse2<set>(_mm_load_si128(reinterpret_cast<const __m128i*>(block)))));
+			if (mask) return block + __builtin_ctz(mask);
+		}
+	}
+
+	#define PUGI__EQ_AVX2(c) _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))
+
+	template <int set> inline __attribute__((target("avx2"))) __m256i scan_match_avx2(__m256i v)
+	{
+		__m256i m;
+		PUGI__SCAN_MATCH(PUGI__EQ_AVX2, _mm256_or_si256, _mm256_andnot_si256, _mm256_set1_epi8(-1));
+	}
+
+	template <int set> PUGI__FN PUGI__SCAN_NO_SANITIZE __attribute__((target("avx2"))) char_t* scan_avx2(char_t* s)
+	{
+		size_t offset = reinterpret_cast<uintptr_t>(s) & 31;
+		char_t* block = s - offset;
+
+		unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(scan_match_avx2<set>(_mm256_load_si256(reinterpret_cast<const __m256i*>(block))))) >> offset;
+		if (mask) return s + __builtin_ctz(mask);
+
+		while (true)
+		{
+			block += 32;
+
+			mask = static_cast<unsigned int>(_mm256_movemask_epi8(scan_match_avx2<set>(_mm256_load_si256(reinterpret_cast<const __m256i*>(block)))));
+			if (mask) return block + __builtin_ctz(mask);
+		}
+	}
+
+	#undef PUGI__SCAN_NO_SANITIZE
+	#undef PUGI__EQ_AVX2
+	#undef PUGI__EQ_SSE2
+	#undef PUGI__SCAN_MATCH
+#endif
+
+	typedef char_t* (*scan_function_t)(char_t*);
+
+	PUGI__FN xml_simd scan_select(xml_simd simd);
+
+	// The scan functions of the selected instruction set, stored in class statics like the allocation functions
+	template <typename T> struct xml_scan_function_storage
+	{
+		static scan_function_t functions[scan_set_count];
+		static xml_simd simd;
+	};
+
+	template <typename T> scan_function_t xml_scan_function_storage<T>::functions[scan_set_count] =
+	{
+		scan_scalar<scan_pcdata>, scan_scalar<scan_attr>, scan_scalar<scan_attr_ws>, scan_scalar<scan_tag>, scan_scalar<scan_nonspace>
+	};
+	template <typename T> xml_simd xml_scan_function_storage<T>::simd = scan_select(simd_avx2);
+
+	typedef xml_scan_function_storage<int> xml_scan;
+
+	// Selects the best instruction set up to simd that the processor supports
+	PUGI__FN xml_simd scan_select(xml_simd simd)
+	{
+	#ifdef PUGI__SIMD_X86
+		// may run before the constructors that initialize the processor features
+		__builtin_cpu_init();
+
+		if (simd >= simd_avx2 && !__builtin_cpu_supports("avx2")) simd = simd_sse2;
+
+		if (simd == simd_avx2)
+		{
+			scan_function_t functions[scan_set_count] = { scan_avx2<scan_pcdata>, scan_avx2<scan_attr>, scan_avx2<scan_attr_ws>, scan_avx2<scan_tag>, scan_avx2<scan_nonspace> };
+			memcpy(xml_scan::functions, functions, sizeof(functions));
+		}
+		else if (simd == simd_sse2)
+		{
+			scan_function_t functions[scan_set_count] = { scan_sse2<scan_pcdata>, scan_sse2<scan_attr>, scan_sse2<scan_attr_ws>, scan_sse2<scan_tag>, scan_sse2<scan_nonspace> };
+			memcpy(xml_scan::functions, functions, sizeof(functions));
+		}
+		else
+	#endif
+		{
+			scan_function_t functions[scan_set_count] = { scan_scalar<scan_pcdata>, scan_scalar<scan_attr>, scan_scalar<scan_attr_ws>, scan_scalar<scan_tag>, scan_scalar<scan_nonspace> };
+			memcpy(xml_scan::functions, functions, sizeof(functions));
+
+			simd = simd_none;
+		}
+
+		return simd;
+	}
+
+	// Skips to the first character of the set: the first characters one at a time, since most runs (names, indentation,
+	// short values) end there, and the rest with the function of the selected instruction set
+	template <int set> inline char_t* scan(char_t* s)
+	{
+		for (char_t* end = s + 16; s != end; ++s)
+			if (scan_stop<set>(*s)) return s;
+
+		return xml_scan::functions[set](s);
+	}
+
 	PUGI__FN char_t* strconv_comment(char_t* s, char_t endch)
 	{
 		gap g;
@@ -2064,7 +2977,7 @@ PUGI__NS_BEGIN
 
 			while (true)
 			{
-				PUGI__SCANWHILE_UNROLL(!PUGI__IS_CHARTYPE(ss, ct_parse_pcdata));
+				s = scan<scan_pcdata>(s);
 
 				if (*s == '<') // PCDATA ends here
 				{
@@ -2185,7 +3098,7 @@ PUGI__NS_BEGIN
 
 			while (true)
 			{
-				PUGI__SCANWHILE_UNROLL(!PUGI__IS_CHARTYPE(ss, ct_parse_attr_ws));
+				s = scan<scan_attr_ws>(s);
 				
 				if (*s == end_quote)
 				{
@@ -2221,7 +3134,7 @@ PUGI__NS_BEGIN
 
 			while (true)
 			{
-				PUGI__SCANWHILE_UNROLL(!PUGI__IS_CHARTYPE(ss, ct_parse_attr));
+				s = scan<scan_attr>(s);
 				
 				if (*s == end_quote)
 				{
@@ -2253,7 +3166,7 @@ PUGI__NS_BEGIN
 
 			while (true)
 			{
-				PUGI__SCANWHILE_UNROLL(!PUGI__IS_CHARTYPE(ss, ct_parse_attr));
+				s = scan<scan_attr>(s);
 				
 				if (*s == end_quote)
 				{
@@ -2314,8 +3227,9 @@ PUGI__NS_BEGIN
 		xml_allocator alloc;
 		char_t* error_offset;
 		xml_parse_status error_status;
+		xml_parse_filter* filter;
 		
-		xml_parser(const xml_allocator& alloc_): alloc(alloc_), error_offset(0), error_status(status_ok)
+		xml_parser(const xml_allocator& alloc_): alloc(alloc_), error_offset(0), error_status(status_ok), filter(0)
 		{
 		}
 
@@ -2638,6 +3552,102 @@ PUGI__NS_BEGIN
 			return s;
 		}
 
+		// Steps over the rest of a start tag, stepping over quoted values; returns the position after its '>'
+		char_t* parse_skip_start_tag(char_t* s)
+		{
+			while (*s != '>')
+			{
+				if (*s == '"' || *s == '\'')
+				{
+					char_t ch = *s++;
+					PUGI__SCANFOR(*s == ch);
+				}
+
+				if (!*s) PUGI__THROW_ERROR(status_bad_start_element, s);
+
+				++s;
+			}
+
+			return s + 1;
+		}
+
+		// Steps over the content of an element up to its end tag and returns the position of the '<' of the end tag.
+		// Only the nesting of the tags is followed: comments, CDATA sections and PIs are stepped over, nothing else is
+		// checked. The names of the start tags met are passed to the filter if report is set.
+		char_t* parse_skip_content(char_t* s, bool report)
+		{
+			size_t depth = 1;
+
+			while (true)
+			{
+				s = scan<scan_tag>(s);
+				if (!*s) PUGI__THROW_ERROR(status_end_element_mismatch, s);
+
+				char_t* tag = s++;
+
+				if (*s == '/')
+				{
+					if (--depth == 0) return tag;
+
+					PUGI__SCANFOR(*s == '>');
+					if (!*s) PUGI__THROW_ERROR(status_bad_end_element, s);
+
+					++s;
+				}
+				else if (s[0] == '!' && s[1] == '-' && s[2] == '-')
+				{
+					s += 3;
+					PUGI__SCANFOR(s[0] == '-' && s[1] == '-' && s[2] == '>');
+					if (!*s) PUGI__THROW_ERROR(status_bad_comment, s);
+
+					s += 3;
+				}
+				else if (s[0] == '!' && s[1] == '[')
+				{
+					s += 2;
+					PUGI__SCANFOR(s[0] == ']' && s[1] == ']' && s[2] == '>');
+					if (!*s) PUGI__THROW_ERROR(status_bad_cdata, s);
+
+					s += 3;
+				}
+				else if (*s == '?')
+				{
+					PUGI__SCANFOR(s[0] == '?' && s[1] == '>');
+					if (!*s) PUGI__THROW_ERROR(status_bad_pi, s);
+
+					s += 2;
+				}
+				else if (PUGI__IS_CHARTYPE(*s, ct_start_symbol))
+				{
+					char_t* name = s;
+					PUGI__SCANWHILE_UNROLL(PUGI__IS_CHARTYPE(ss, ct_symbol));
+					if (report) filter->skipped(name, static_cast<size_t>(s - name));
+
+					s = parse_skip_start_tag(s);
+					if (!s) return s;
+
+					if (s[-2] != '/') ++depth;
+				}
+				else PUGI__THROW_ERROR(status_unrecognized_tag, s);
+			}
+		}
+
+		// Steps over the element whose name ends at s and its whole subtree, passing the names of the start tags inside
+		// it to the filter
+		char_t* parse_skip_element(char_t* s)
+		{
+			s = parse_skip_start_tag(s);
+			if (!s || s[-2] == '/') return s;
+
+			s = parse_skip_content(s, true);
+			if (!s) return s;
+
+			PUGI__SCANFOR(*s == '>');
+			if (!*s) PUGI__THROW_ERROR(status_bad_end_element, s);
+
+			return s + 1;
+		}
+
 		char_t* parse_tree(char_t* s, xml_node_struct* root, unsigned int optmsk, char_t endch)
 		{
 			strconv_attribute_t strconv_attribute = get_strconv_attribute(optmsk);
@@ -2645,6 +3655,7 @@ PUGI__NS_BEGIN
 			
 			char_t ch = 0;
 			xml_node_struct* cursor = root;
+			xml_node_struct* deferred = 0;
 			char_t* mark = s;
 
 			while (*s != 0)
@@ -2656,7 +3667,28 @@ PUGI__NS_BEGIN
 				LOC_TAG:
 					if (PUGI__IS_CHARTYPE(*s, ct_start_symbol)) // '<#...'
 					{
-						PUGI__PUSHNODE(node_element); // Append a new node to the tree.
+						if (filter)
+						{
+							char_t* name = s;
+							PUGI__SCANWHILE_UNROLL(PUGI__IS_CHARTYPE(ss, ct_symbol));
+
+							xml_filter_result action = filter->element(name, static_cast<size_t>(s - name));
+
+							if (action == filter_skip)
+							{
+								s = parse_skip_element(s);
+								if (!s) return s;
+
+								continue;
+							}
+
+							s = name;
+
+							PUGI__PUSHNODE(node_element); // Append a new node to the tree.
+
+							if (action == filter_defer) deferred = cursor;
+						}
+						else PUGI__PUSHNODE(node_element); // Append a new node to the tree.
 
 						cursor->name = s;
 
@@ -2763,21 +3795,63 @@ PUGI__NS_BEGIN
 							if (endch != '>') PUGI__THROW_ERROR(status_bad_start_element, s);
 						}
 						else PUGI__THROW_ERROR(status_bad_start_element, s);
-					}
-					else if (*s == '/')
-					{
-						++s;
 
-						char_t* name = cursor->name;
-						if (!name) PUGI__THROW_ERROR(status_end_element_mismatch, s);
-						
-						while (PUGI__IS_CHARTYPE(*s, ct_symbol))
+						if (deferred)
 						{
-							if (*s++ != *name++) PUGI__THROW_ERROR(status_end_element_mismatch, s);
-						}
+							// the content is kept as the value of the element until xml_node::expand parses it
+							if (cursor == deferred)
+							{
+								char_t* content = s;
 
-						if (*name)
-						{
+								s = parse_skip_content(s, false);
+								if (!s) return s;
+
+								if (s != content) cursor->value = content;
+
+								*s++ = 0; // terminates the content, s is on the '/' of the end tag
+								++s;
+
+								char_t* name = cursor->name;
+
+								while (PUGI__IS_CHARTYPE(*s, ct_symbol))
+								{
+									if (*s++ != *name++) PUGI__THROW_ERROR(status_end_element_mismatch, s);
+								}
+
+								if (*name) PUGI__THROW_ERROR(status_end_element_mismatch, s);
+
+								PUGI__POPNODE(); // Pop.
+
+								PUGI__SKIPWS();
+
+								if (*s == 0)
+								{
+									if (endch != '>') PUGI__THROW_ERROR(status_bad_end_element, s);
+								}
+								else
+								{
+									if (*s != '>') PUGI__THROW_ERROR(status_bad_end_element, s);
+									++s;
+								}
+							}
+
+							deferred = 0;
+						}
+					}
+					else if (*s == '/')
+					{
+						++s;
+
+						char_t* name = cursor->name;
+						if (!name) PUGI__THROW_ERROR(status_end_element_mismatch, s);
+						
+						while (PUGI__IS_CHARTYPE(*s, ct_symbol))
+						{
+							if (*s++ != *name++) PUGI__THROW_ERROR(status_end_element_mismatch, s);
+						}
+
+						if (*name)
+						{
 							if (*s == 0 && name[0] == endch && name[1] == 0) PUGI__THROW_ERROR(status_bad_end_element, s);
 							else PUGI__THROW_ERROR(status_end_element_mismatch, s);
 						}
@@ -2816,7 +3890,7 @@ PUGI__NS_BEGIN
 				{
 					mark = s; // Save this offset while searching for a terminator.
 
-					PUGI__SKIPWS(); // Eat whitespace if no genuine PCDATA here.
+					s = scan<scan_nonspace>(s); // Eat whitespace if no genuine PCDATA here.
 
 					if (*s == '<' || !*s)
 					{
@@ -2849,7 +3923,7 @@ PUGI__NS_BEGIN
 					}
 					else
 					{
-						PUGI__SCANFOR(*s == '<'); // '...<'
+						s = scan<scan_tag>(s); // '...<'
 						if (!*s) break;
 						
 						++s;
@@ -2891,6 +3965,26 @@ PUGI__NS_BEGIN
 			return false;
 		}
 
+		// Parses the content of an element deferred by the filter (zero-terminated, in the buffer of the document)
+		static xml_parse_result parse_deferred(char_t* contents, xml_document_struct* xmldoc, xml_node_struct* node, unsigned int optmsk)
+		{
+			xml_allocator& alloc_ = *static_cast<xml_allocator*>(xmldoc);
+
+			xml_parser parser(alloc_);
+
+			// name of the node has to be NULL while parsing - otherwise closing node mismatches will not be detected at the top level
+			char_t* name = node->name;
+			node->name = 0;
+
+			parser.parse_tree(contents, node, optmsk, 0);
+
+			node->name = name;
+
+			alloc_ = parser.alloc;
+
+			return make_parse_result(parser.error_status, parser.error_offset ? parser.error_offset - xmldoc->buffer : 0);
+		}
+
 		static xml_parse_result parse(char_t* buffer, size_t length, xml_document_struct* xmldoc, xml_node_struct* root, unsigned int optmsk)
 		{
 			// allocator object is a part of document object
@@ -2905,6 +3999,10 @@ PUGI__NS_BEGIN
 	
 			// create parser on stack
 			xml_parser parser(alloc_);
+			parser.filter = xmldoc->filter;
+
+			// deferred contents are parsed later with the same options
+			xmldoc->options = optmsk;
 
 			// save last character and make buffer zero-terminated (speeds up parsing)
 			char_t endch = buffer[length - 1];
@@ -4083,6 +5181,90 @@ PUGI__NS_BEGIN
 		return size;
 	}
 
+#ifndef PUGIXML_WCHAR_MODE
+	// Reads utf16 file a block at a time, once to get its length in utf8 units and once to convert it, so that the utf16 text
+	// (twice the size of utf8 for most documents) is never in memory as a whole
+	template <typename opt_swap> PUGI__FN xml_parse_result load_file_utf16_impl(xml_document& doc, FILE* file, size_t size, unsigned int options, xml_encoding encoding, opt_swap)
+	{
+		const size_t block_capacity = 16384;
+		uint16_t block[block_capacity];
+
+		uint8_t* buffer = 0;
+		size_t length = 0;
+
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			if (fseek(file, 0, SEEK_SET) != 0) break;
+
+			size_t left = size / sizeof(uint16_t);
+			size_t carry = 0;
+			uint8_t* out = buffer;
+
+			while (left > 0)
+			{
+				size_t count = (block_capacity - carry < left) ? block_capacity - carry : left;
+				if (fread(block + carry, sizeof(uint16_t), count, file) != count) break;
+
+				const uint16_t* data = block;
+				size_t data_length = carry + count;
+
+				// the parser skips the byte order mark anyway
+				if (left == size / sizeof(uint16_t) && (opt_swap::value ? endian_swap(*data) : *data) == 0xfeff)
+				{
+					data++;
+					data_length--;
+				}
+
+				left -= count;
+
+				// a surrogate pair lead at the end of the block is decoded with the next block
+				carry = (left > 0 && data_length > 0 && static_cast<unsigned int>((opt_swap::value ? endian_swap(data[data_length - 1]) : data[data_length - 1]) - 0xD800) < 0x400) ? 1 : 0;
+				data_length -= carry;
+
+				if (pass == 0)
+				{
+					bool fits;
+					length += get_utf16_utf8_length<opt_swap>(data, data_length, fits);
+				}
+				else
+					out = convert_utf16_utf8<opt_swap>(data, data_length, out);
+
+				if (carry) block[0] = data[data_length];
+			}
+
+			if (left > 0) break;
+
+			if (pass == 0)
+			{
+				buffer = static_cast<uint8_t*>(xml_memory::allocate(length + 1));
+
+				if (!buffer)
+				{
+					fclose(file);
+					return make_parse_result(status_out_of_memory);
+				}
+			}
+			else
+			{
+				assert(out == buffer + length);
+				*out = 0;
+
+				fclose(file);
+
+				xml_parse_result result = doc.load_buffer_inplace_own(buffer, length + 1, options, encoding_utf8);
+				result.encoding = encoding;
+
+				return result;
+			}
+		}
+
+		if (buffer) xml_memory::deallocate(buffer);
+		fclose(file);
+
+		return make_parse_result(status_io_error);
+	}
+#endif
+
 	PUGI__FN xml_parse_result load_file_impl(xml_document& doc, FILE* file, unsigned int options, xml_encoding encoding)
 	{
 		if (!file) return make_parse_result(status_file_not_found);
@@ -4096,7 +5278,29 @@ PUGI__NS_BEGIN
 			fclose(file);
 			return make_parse_result(size_status);
 		}
-		
+
+	#ifndef PUGIXML_WCHAR_MODE
+		// utf16 is converted while it is read
+		uint8_t head[4] = {0, 0, 0, 0};
+		size_t head_size = fread(head, 1, sizeof(head), file);
+		xml_encoding head_encoding = get_buffer_encoding(encoding, head, head_size);
+
+		if (head_encoding == encoding_utf16_le || head_encoding == encoding_utf16_be)
+		{
+			xml_encoding native_encoding = is_little_endian() ? encoding_utf16_le : encoding_utf16_be;
+
+			return (native_encoding == head_encoding) ?
+				load_file_utf16_impl(doc, file, size, options, head_encoding, opt_false()) :
+				load_file_utf16_impl(doc, file, size, options, head_encoding, opt_true());
+		}
+
+		if (fseek(file, 0, SEEK_SET) != 0)
+		{
+			fclose(file);
+			return make_parse_result(status_io_error);
+		}
+	#endif
+
 		size_t max_suffix_size = sizeof(char_t);
 
 		// allocate buffer for the whole file
@@ -4344,7 +5548,8 @@ PUGI__NS_BEGIN
 		char_t* buffer = 0;
 		size_t length = 0;
 
-		if (!impl::convert_buffer(buffer, length, buffer_encoding, contents, size, is_mutable)) return impl::make_parse_result(status_out_of_memory);
+		// a buffer we own is freed after a conversion, so only the others are converted over
+		if (!impl::convert_buffer(buffer, length, buffer_encoding, contents, size, is_mutable, !own)) return impl::make_parse_result(status_out_of_memory);
 		
 		// delete original buffer if we performed a conversion
 		if (own && buffer != contents && contents) impl::xml_memory::deallocate(contents);
@@ -4355,6 +5560,8 @@ PUGI__NS_BEGIN
 		// parse
 		xml_parse_result res = impl::xml_parser::parse(buffer, length, doc, root, options);
 
+		if (res && (options & (parse_intern_names | parse_intern_values)) && !impl::intern_strings(doc, doc, options)) res = impl::make_parse_result(status_out_of_memory);
+
 		// remember encoding
 		res.encoding = buffer_encoding;
 
@@ -4411,6 +5618,14 @@ namespace pugi
 	{
 	}
 
+	PUGI__FN xml_parse_filter::~xml_parse_filter()
+	{
+	}
+
+	PUGI__FN void xml_parse_filter::skipped(const char_t*, size_t)
+	{
+	}
+
 	PUGI__FN int xml_tree_walker::depth() const
 	{
 		return _depth;
@@ -4608,6 +5823,8 @@ namespace pugi
 	PUGI__FN bool xml_attribute::set_name(const char_t* rhs)
 	{
 		if (!_attr) return false;
+
+		impl::document_changed(_attr);
 		
 		return impl::strcpy_insitu(_attr->name, _attr->header, impl::xml_memory_page_name_allocated_mask, rhs);
 	}
@@ -4900,7 +6117,10 @@ namespace pugi
 		{
 		case node_pi:
 		case node_declaration:
+			return impl::strcpy_insitu(_root->name, _root->header, impl::xml_memory_page_name_allocated_mask, rhs);
+
 		case node_element:
+			impl::document_changed(_root);
 			return impl::strcpy_insitu(_root->name, _root->header, impl::xml_memory_page_name_allocated_mask, rhs);
 
 		default:
@@ -4931,6 +6151,8 @@ namespace pugi
 		xml_attribute a(impl::allocate_attribute(impl::get_allocator(_root)));
 		if (!a) return xml_attribute();
 
+		impl::document_changed(_root);
+
 		impl::append_attribute(a._attr, _root);
 
 		a.set_name(name_);
@@ -4945,6 +6167,8 @@ namespace pugi
 		xml_attribute a(impl::allocate_attribute(impl::get_allocator(_root)));
 		if (!a) return xml_attribute();
 
+		impl::document_changed(_root);
+
 		impl::prepend_attribute(a._attr, _root);
 
 		a.set_name(name_);
@@ -4960,6 +6184,8 @@ namespace pugi
 		xml_attribute a(impl::allocate_attribute(impl::get_allocator(_root)));
 		if (!a) return xml_attribute();
 
+		impl::document_changed(_root);
+
 		impl::insert_attribute_after(a._attr, attr._attr, _root);
 
 		a.set_name(name_);
@@ -4975,6 +6201,8 @@ namespace pugi
 		xml_attribute a(impl::allocate_attribute(impl::get_allocator(_root)));
 		if (!a) return xml_attribute();
 
+		impl::document_changed(_root);
+
 		impl::insert_attribute_before(a._attr, attr._attr, _root);
 
 		a.set_name(name_);
@@ -5029,6 +6257,8 @@ namespace pugi
 		xml_node n(impl::allocate_node(impl::get_allocator(_root), type_));
 		if (!n) return xml_node();
 
+		impl::document_changed(_root);
+
 		impl::append_node(n._root, _root);
 
 		if (type_ == node_declaration) n.set_name(PUGIXML_TEXT("xml"));
@@ -5043,6 +6273,8 @@ namespace pugi
 		xml_node n(impl::allocate_node(impl::get_allocator(_root), type_));
 		if (!n) return xml_node();
 
+		impl::document_changed(_root);
+
 		impl::prepend_node(n._root, _root);
 				
 		if (type_ == node_declaration) n.set_name(PUGIXML_TEXT("xml"));
@@ -5058,6 +6290,8 @@ namespace pugi
 		xml_node n(impl::allocate_node(impl::get_allocator(_root), type_));
 		if (!n) return xml_node();
 
+		impl::document_changed(_root);
+
 		impl::insert_node_before(n._root, node._root);
 
 		if (type_ == node_declaration) n.set_name(PUGIXML_TEXT("xml"));
@@ -5073,6 +6307,8 @@ namespace pugi
 		xml_node n(impl::allocate_node(impl::get_allocator(_root), type_));
 		if (!n) return xml_node();
 
+		impl::document_changed(_root);
+
 		impl::insert_node_after(n._root, node._root);
 
 		if (type_ == node_declaration) n.set_name(PUGIXML_TEXT("xml"));
@@ -5124,6 +6360,8 @@ namespace pugi
 		xml_node n(impl::allocate_node(impl::get_allocator(_root), type_));
 		if (!n) return xml_node();
 
+		impl::document_changed(_root);
+
 		impl::append_node(n._root, _root);
 		impl::node_copy_tree(n._root, proto._root);
 
@@ -5138,6 +6376,8 @@ namespace pugi
 		xml_node n(impl::allocate_node(impl::get_allocator(_root), type_));
 		if (!n) return xml_node();
 
+		impl::document_changed(_root);
+
 		impl::prepend_node(n._root, _root);
 		impl::node_copy_tree(n._root, proto._root);
 
@@ -5153,6 +6393,8 @@ namespace pugi
 		xml_node n(impl::allocate_node(impl::get_allocator(_root), type_));
 		if (!n) return xml_node();
 
+		impl::document_changed(_root);
+
 		impl::insert_node_after(n._root, node._root);
 		impl::node_copy_tree(n._root, proto._root);
 
@@ -5168,6 +6410,8 @@ namespace pugi
 		xml_node n(impl::allocate_node(impl::get_allocator(_root), type_));
 		if (!n) return xml_node();
 
+		impl::document_changed(_root);
+
 		impl::insert_node_before(n._root, node._root);
 		impl::node_copy_tree(n._root, proto._root);
 
@@ -5180,6 +6424,7 @@ namespace pugi
 
 		// disable document_buffer_order optimization since moving nodes around changes document order without changing buffer pointers
 		impl::get_document(_root).header |= impl::xml_memory_page_contents_shared_mask;
+		impl::document_changed(_root);
 
 		impl::remove_node(moved._root);
 		impl::append_node(moved._root, _root);
@@ -5193,6 +6438,7 @@ namespace pugi
 
 		// disable document_buffer_order optimization since moving nodes around changes document order without changing buffer pointers
 		impl::get_document(_root).header |= impl::xml_memory_page_contents_shared_mask;
+		impl::document_changed(_root);
 
 		impl::remove_node(moved._root);
 		impl::prepend_node(moved._root, _root);
@@ -5208,6 +6454,7 @@ namespace pugi
 
 		// disable document_buffer_order optimization since moving nodes around changes document order without changing buffer pointers
 		impl::get_document(_root).header |= impl::xml_memory_page_contents_shared_mask;
+		impl::document_changed(_root);
 
 		impl::remove_node(moved._root);
 		impl::insert_node_after(moved._root, node._root);
@@ -5223,6 +6470,7 @@ namespace pugi
 
 		// disable document_buffer_order optimization since moving nodes around changes document order without changing buffer pointers
 		impl::get_document(_root).header |= impl::xml_memory_page_contents_shared_mask;
+		impl::document_changed(_root);
 
 		impl::remove_node(moved._root);
 		impl::insert_node_before(moved._root, node._root);
@@ -5255,12 +6503,39 @@ namespace pugi
 	{
 		if (!_root || !n._root || n._root->parent != _root) return false;
 
+		impl::document_changed(_root);
 		impl::remove_node(n._root);
 		impl::destroy_node(n._root, impl::get_allocator(_root));
 
 		return true;
 	}
 
+	PUGI__FN bool xml_node::deferred() const
+	{
+		return _root && PUGI__NODETYPE(_root) == node_element && _root->value;
+	}
+
+	PUGI__FN xml_parse_result xml_node::expand()
+	{
+		if (!deferred()) return impl::make_parse_result(status_ok);
+
+		impl::xml_document_struct* doc = &impl::get_document(_root);
+
+		// the new names are interned below, so the atoms stay complete
+		bool complete = doc->atoms && doc->atoms->complete;
+		impl::document_changed(_root);
+		if (doc->atoms) doc->atoms->complete = complete;
+
+		char_t* contents = _root->value;
+		_root->value = 0;
+
+		xml_parse_result res = impl::xml_parser::parse_deferred(contents, doc, _root, doc->options);
+
+		if (res && (doc->options & (parse_intern_names | parse_intern_values)) && !impl::intern_strings(doc, _root, doc->options)) res = impl::make_parse_result(status_out_of_memory);
+
+		return res;
+	}
+
 	PUGI__FN xml_parse_result xml_node::append_buffer(const void* contents, size_t size, unsigned int options, xml_encoding encoding)
 	{
 		// append_buffer is only valid for elements/documents
@@ -5271,6 +6546,7 @@ namespace pugi
 
 		// disable document_buffer_order optimization since in a document with multiple buffers comparing buffer pointers does not make sense
 		doc->header |= impl::xml_memory_page_contents_shared_mask;
+		impl::document_changed(_root);
 		
 		// get extra buffer element (we'll store the document fragment buffer there so that we can deallocate it later)
 		impl::xml_memory_page* page = 0;
@@ -5982,11 +7258,13 @@ namespace pugi
 
 		case status_no_document_element: return "No document element found";
 
+		case status_unsupported_encoding: return "Document encoding is not supported";
+
 		default: return "Unknown error";
 		}
 	}
 
-	PUGI__FN xml_document::xml_document(): _buffer(0)
+	PUGI__FN xml_document::xml_document(): _buffer(0), _filter(0)
 	{
 		create();
 	}
@@ -6033,6 +7311,9 @@ namespace pugi
 		// setup sentinel page
 		page->allocator = static_cast<impl::xml_document_struct*>(_root);
 
+		// the filter applies to all the loads until it is changed
+		static_cast<impl::xml_document_struct*>(_root)->filter = _filter;
+
 		// verify the document allocation
 		assert(reinterpret_cast<char*>(_root) + sizeof(impl::xml_document_struct) <= _memory + sizeof(_memory));
 	}
@@ -6048,6 +7329,22 @@ namespace pugi
 			_buffer = 0;
 		}
 
+		impl::document_changed(_root);
+
+		impl::xml_document_struct* doc = static_cast<impl::xml_document_struct*>(_root);
+
+		if (doc->atoms)
+		{
+			impl::string_atoms_destroy(doc->atoms);
+			doc->atoms = 0;
+		}
+
+		if (doc->value_atoms)
+		{
+			impl::string_atoms_destroy(doc->value_atoms);
+			doc->value_atoms = 0;
+		}
+
 		// destroy extra buffers (note: no need to destroy linked list nodes, they're allocated using document allocator)
 		for (impl::xml_extra_buffer* extra = static_cast<impl::xml_document_struct*>(_root)->extra_buffers; extra; extra = extra->next)
 		{
@@ -6158,55 +7455,630 @@ namespace pugi
 		#endif
 		}
 
-		if (!(flags & format_no_declaration) && !impl::has_declaration(_root))
-		{
-			buffered_writer.write_string(PUGIXML_TEXT("<?xml version=\"1.0\""));
-			if (encoding == encoding_latin1) buffered_writer.write_string(PUGIXML_TEXT(" encoding=\"ISO-8859-1\""));
-			buffered_writer.write('?', '>');
-			if (!(flags & format_raw)) buffered_writer.write('\n');
+		if (!(flags & format_no_declaration) && !impl::has_declaration(_root))
+		{
+			buffered_writer.write_string(PUGIXML_TEXT("<?xml version=\"1.0\""));
+			if (encoding == encoding_latin1) buffered_writer.write_string(PUGIXML_TEXT(" encoding=\"ISO-8859-1\""));
+			buffered_writer.write('?', '>');
+			if (!(flags & format_raw)) buffered_writer.write('\n');
+		}
+
+		impl::node_output(buffered_writer, _root, indent, flags, 0);
+	}
+
+#ifndef PUGIXML_NO_STL
+	PUGI__FN void xml_document::save(std::basic_ostream<char, std::char_traits<char> >& stream, const char_t* indent, unsigned int flags, xml_encoding encoding) const
+	{
+		xml_writer_stream writer(stream);
+
+		save(writer, indent, flags, encoding);
+	}
+
+	PUGI__FN void xml_document::save(std::basic_ostream<wchar_t, std::char_traits<wchar_t> >& stream, const char_t* indent, unsigned int flags) const
+	{
+		xml_writer_stream writer(stream);
+
+		save(writer, indent, flags, encoding_wchar);
+	}
+#endif
+
+	PUGI__FN bool xml_document::save_file(const char* path_, const char_t* indent, unsigned int flags, xml_encoding encoding) const
+	{
+		FILE* file = fopen(path_, (flags & format_save_file_text) ? "w" : "wb");
+		return impl::save_file_impl(*this, file, indent, flags, encoding);
+	}
+
+	PUGI__FN bool xml_document::save_file(const wchar_t* path_, const char_t* indent, unsigned int flags, xml_encoding encoding) const
+	{
+		FILE* file = impl::open_file_wide(path_, (flags & format_save_file_text) ? L"w" : L"wb");
+		return impl::save_file_impl(*this, file, indent, flags, encoding);
+	}
+
+	PUGI__FN size_t xml_document::build_element_index()
+	{
+		assert(_root);
+
+		impl::document_changed(_root);
+
+		impl::xml_element_index* index = impl::element_index_build(_root);
+		if (!index) return 0;
+
+		static_cast<impl::xml_document_struct*>(_root)->element_index = index;
+
+		return index->memory;
+	}
+
+	PUGI__FN xml_intern_stats xml_document::intern_stats() const
+	{
+		assert(_root);
+
+		xml_intern_stats result = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+		impl::xml_document_struct* doc = static_cast<impl::xml_document_struct*>(_root);
+
+		if (impl::xml_string_atoms* atoms = doc->atoms)
+		{
+			result.names = atoms->strings;
+			result.unique_names = atoms->distinct;
+			result.name_bytes = atoms->string_bytes;
+			result.unique_name_bytes = atoms->atom_bytes;
+			result.table_bytes += sizeof(impl::xml_string_atoms) + atoms->capacity * sizeof(impl::xml_string_atoms::entry);
+		}
+
+		if (impl::xml_string_atoms* atoms = doc->value_atoms)
+		{
+			result.values = atoms->strings;
+			result.unique_values = atoms->distinct;
+			result.value_bytes = atoms->string_bytes;
+			result.unique_value_bytes = atoms->atom_bytes;
+			result.value_table_bytes = atoms->table_bytes;
+		}
+
+		return result;
+	}
+
+	PUGI__FN void xml_document::set_parse_filter(xml_parse_filter* filter)
+	{
+		assert(_root);
+
+		_filter = filter;
+		static_cast<impl::xml_document_struct*>(_root)->filter = filter;
+	}
+
+	PUGI__FN size_t xml_document::element_index_memory() const
+	{
+		assert(_root);
+
+		impl::xml_element_index* index = static_cast<impl::xml_document_struct*>(_root)->element_index;
+
+		return index ? index->memory : 0;
+	}
+
+	PUGI__FN xml_node xml_document::document_element() const
+	{
+		assert(_root);
+
+		for (xml_node_struct* i = _root->first_child; i; i = i->next_sibling)
+			if (PUGI__NODETYPE(i) == node_element)
+				return xml_node(i);
+
+		return xml_node();
+	}
+
+#ifndef PUGIXML_WCHAR_MODE
+	// the parser tables live in impl
+	#define PUGI__PULL_IS_CHARTYPE(c, ct) PUGI__IS_CHARTYPE_IMPL(c, impl::ct, impl::chartype_table)
+
+	PUGI__FN xml_pull_parser::xml_pull_parser(size_t buffer_size): _file(0), _options(parse_default), _buffer(0), _capacity(buffer_size < 64 ? 64 : buffer_size), _cur(0), _end(0), _eof(true), _consumed(0),
+		_stack(0), _stack_size(0), _stack_capacity(0), _depth(0), _pending_end(false), _attributes(0), _attributes_capacity(0), _name(0), _value(0), _value_length(0), _status(status_ok), _offset(0)
+	{
+	}
+
+	PUGI__FN xml_pull_parser::~xml_pull_parser()
+	{
+		close();
+
+		if (_buffer) impl::xml_memory::deallocate(_buffer);
+		if (_stack) impl::xml_memory::deallocate(_stack);
+		if (_attributes) impl::xml_memory::deallocate(_attributes);
+	}
+
+	PUGI__FN bool xml_pull_parser::open(const char* path, unsigned int options)
+	{
+		close();
+
+		_status = status_ok;
+		_offset = 0;
+
+		if (!_buffer) _buffer = static_cast<char_t*>(impl::xml_memory::allocate((_capacity + 1) * sizeof(char_t)));
+		if (!_attributes)
+		{
+			_attributes_capacity = 33;
+			_attributes = static_cast<const char_t**>(impl::xml_memory::allocate(_attributes_capacity * sizeof(const char_t*)));
+		}
+
+		if (!_buffer || !_attributes)
+		{
+			_status = status_out_of_memory;
+			return false;
+		}
+
+		FILE* file = fopen(path, "rb");
+
+		if (!file)
+		{
+			_status = status_file_not_found;
+			return false;
+		}
+
+		_file = file;
+		_options = options;
+		_cur = _end = _buffer;
+		*_end = 0;
+		_eof = false;
+		_consumed = 0;
+		_stack_size = 0;
+		_depth = 0;
+		_pending_end = false;
+
+		fill();
+
+		// only UTF-8 is handled, the other encodings would need a conversion of each buffer
+		uint8_t d[4] = {0, 0, 0, 0};
+		for (size_t i = 0; i < 4 && _cur + i < _end; ++i) d[i] = static_cast<uint8_t>(_cur[i]);
+
+		if (_end - _cur >= 4 && impl::guess_buffer_encoding(d[0], d[1], d[2], d[3]) != encoding_utf8)
+		{
+			close();
+			_status = status_unsupported_encoding;
+			return false;
+		}
+
+		if (d[0] == 0xef && d[1] == 0xbb && d[2] == 0xbf) _cur += 3;
+
+		return true;
+	}
+
+	PUGI__FN void xml_pull_parser::close()
+	{
+		if (_file) fclose(static_cast<FILE*>(_file));
+
+		_file = 0;
+		_cur = _end = _buffer;
+		_eof = true;
+	}
+
+	PUGI__FN bool xml_pull_parser::fill()
+	{
+		size_t left = static_cast<size_t>(_end - _cur);
+
+		// slide the unconsumed bytes to the front
+		if (_cur != _buffer)
+		{
+			memmove(_buffer, _cur, left * sizeof(char_t));
+			_consumed += static_cast<size_t>(_cur - _buffer);
+			_cur = _buffer;
+			_end = _buffer + left;
+			*_end = 0;
+		}
+
+		if (_eof) return false;
+
+		// a single construct larger than the buffer
+		if (left == _capacity)
+		{
+			char_t* buffer = static_cast<char_t*>(impl::xml_memory::allocate((_capacity * 2 + 1) * sizeof(char_t)));
+
+			if (!buffer)
+			{
+				fail(status_out_of_memory, _cur);
+				return false;
+			}
+
+			memcpy(buffer, _buffer, left * sizeof(char_t));
+			impl::xml_memory::deallocate(_buffer);
+
+			_buffer = _cur = buffer;
+			_end = buffer + left;
+			_capacity *= 2;
+		}
+
+		size_t read_size = fread(_end, sizeof(char_t), _capacity - left, static_cast<FILE*>(_file));
+
+		if (read_size == 0) _eof = true;
+
+		_end += read_size;
+		*_end = 0;
+
+		return read_size > 0;
+	}
+
+	PUGI__FN char_t* xml_pull_parser::find_markup_end()
+	{
+		char_t* s = _cur;
+
+		// not enough to tell what kind of markup this is
+		if (!_eof && _end - s < 9) return 0;
+
+		if (s[1] == '!' && s[2] == '-' && s[3] == '-')
+		{
+			for (s += 4; s + 2 < _end; ++s)
+				if (s[0] == '-' && s[1] == '-' && s[2] == '>') return s + 3;
+		}
+		else if (s[1] == '!' && memcmp(s + 2, "[CDATA[", 7) == 0)
+		{
+			for (s += 9; s + 2 < _end; ++s)
+				if (s[0] == ']' && s[1] == ']' && s[2] == '>') return s + 3;
+		}
+		else if (s[1] == '?')
+		{
+			for (s += 2; s + 1 < _end; ++s)
+				if (s[0] == '?' && s[1] == '>') return s + 2;
+		}
+		else
+		{
+			// tags and <!DOCTYPE ...>: the first '>' outside quotes and [...]
+			char_t quote = 0;
+			size_t group = 0;
+
+			for (++s; s < _end; ++s)
+			{
+				if (quote)
+				{
+					if (*s == quote) quote = 0;
+				}
+				else if (*s == '"' || *s == '\'') quote = *s;
+				else if (*s == '[') ++group;
+				else if (*s == ']' && group) --group;
+				else if (*s == '>' && !group) return s + 1;
+			}
+		}
+
+		return 0;
+	}
+
+	PUGI__FN xml_pull_event xml_pull_parser::fail(xml_parse_status status, const char_t* where)
+	{
+		_status = status;
+		_offset = static_cast<ptrdiff_t>(_consumed + (where - _buffer));
+
+		return pull_error;
+	}
+
+	PUGI__FN bool xml_pull_parser::push(const char_t* name)
+	{
+		size_t length = impl::strlength(name) + 1;
+
+		if (_stack_size + length > _stack_capacity)
+		{
+			size_t capacity = (_stack_capacity + length) * 2;
+			char_t* stack = static_cast<char_t*>(impl::xml_memory::allocate(capacity * sizeof(char_t)));
+			if (!stack) return false;
+
+			if (_stack)
+			{
+				memcpy(stack, _stack, _stack_size * sizeof(char_t));
+				impl::xml_memory::deallocate(_stack);
+			}
+
+			_stack = stack;
+			_stack_capacity = capacity;
+		}
+
+		memcpy(_stack + _stack_size, name, length * sizeof(char_t));
+		_stack_size += length;
+		_depth++;
+
+		return true;
+	}
+
+	PUGI__FN bool xml_pull_parser::push_attribute(const char_t* name, const char_t* value, size_t& count)
+	{
+		// room for the pair and the terminating zero
+		if (count + 3 > _attributes_capacity)
+		{
+			size_t capacity = _attributes_capacity * 2;
+			const char_t** attributes = static_cast<const char_t**>(impl::xml_memory::allocate(capacity * sizeof(const char_t*)));
+			if (!attributes) return false;
+
+			memcpy(attributes, _attributes, count * sizeof(const char_t*));
+			impl::xml_memory::deallocate(_attributes);
+
+			_attributes = attributes;
+			_attributes_capacity = capacity;
+		}
+
+		_attributes[count++] = name;
+		_attributes[count++] = value;
+
+		return true;
+	}
+
+	PUGI__FN xml_pull_event xml_pull_parser::start_element(char_t* s, char_t* end)
+	{
+		impl::strconv_attribute_t strconv_attribute = impl::get_strconv_attribute(_options);
+
+		// the whole tag is in the buffer: terminate it so that the scanners stop there at the latest
+		char_t saved = *end;
+		*end = 0;
+
+		char_t ch = 0;
+		size_t count = 0;
+		bool empty = false;
+
+		if (!PUGI__PULL_IS_CHARTYPE(*s, ct_start_symbol)) return fail(status_unrecognized_tag, s);
+
+		_name = s;
+
+		while (PUGI__PULL_IS_CHARTYPE(*s, ct_symbol)) ++s;
+		PUGI__ENDSEG();
+
+		if (ch == '/')
+		{
+			if (*s != '>') return fail(status_bad_start_element, s);
+
+			empty = true;
+		}
+		else if (PUGI__PULL_IS_CHARTYPE(ch, ct_space))
+		{
+			while (true)
+			{
+				while (PUGI__PULL_IS_CHARTYPE(*s, ct_space)) ++s;
+
+				if (PUGI__PULL_IS_CHARTYPE(*s, ct_start_symbol))
+				{
+					char_t* name = s;
+
+					while (PUGI__PULL_IS_CHARTYPE(*s, ct_symbol)) ++s;
+					PUGI__ENDSEG();
+
+					if (PUGI__PULL_IS_CHARTYPE(ch, ct_space))
+					{
+						while (PUGI__PULL_IS_CHARTYPE(*s, ct_space)) ++s;
+
+						ch = *s;
+						++s;
+					}
+
+					if (ch != '=') return fail(status_bad_attribute, s);
+
+					while (PUGI__PULL_IS_CHARTYPE(*s, ct_space)) ++s;
+
+					if (*s != '"' && *s != '\'') return fail(status_bad_attribute, s);
+
+					ch = *s;
+					++s;
+
+					char_t* value = s;
+
+					s = strconv_attribute(s, ch);
+
+					if (!s) return fail(status_bad_attribute, value);
+					if (PUGI__PULL_IS_CHARTYPE(*s, ct_start_symbol)) return fail(status_bad_attribute, s);
+
+					if (!push_attribute(name, value, count)) return fail(status_out_of_memory, s);
+				}
+				else if (*s == '/')
+				{
+					++s;
+
+					if (*s != '>') return fail(status_bad_start_element, s);
+
+					empty = true;
+					break;
+				}
+				else if (*s == '>') break;
+				else return fail(status_bad_start_element, s);
+			}
+		}
+		else if (ch != '>') return fail(status_bad_start_element, s);
+
+		*end = saved;
+		_attributes[count] = 0;
+
+		if (!push(_name)) return fail(status_out_of_memory, _name);
+
+		_pending_end = empty;
+
+		return pull_start_element;
+	}
+
+	PUGI__FN xml_pull_event xml_pull_parser::end_element(char_t* s)
+	{
+		if (_depth == 0) return fail(status_end_element_mismatch, s);
+
+		// the name of the innermost open element starts after the previous zero
+		char_t* top = _stack + _stack_size - 1;
+		while (top > _stack && top[-1] != 0) --top;
+
+		const char_t* name = top;
+
+		while (PUGI__PULL_IS_CHARTYPE(*s, ct_symbol))
+		{
+			if (*s++ != *name++) return fail(status_end_element_mismatch, s);
+		}
+
+		if (*name) return fail(status_end_element_mismatch, s);
+
+		while (PUGI__PULL_IS_CHARTYPE(*s, ct_space)) ++s;
+
+		if (*s != '>') return fail(status_bad_end_element, s);
+
+		// popped, but the name stays readable until the next push
+		_name = top;
+		_stack_size = static_cast<size_t>(top - _stack);
+		_depth--;
+
+		return pull_end_element;
+	}
+
+	PUGI__FN bool xml_pull_parser::pcdata()
+	{
+		char_t* s = _cur;
+		char_t* end = static_cast<char_t*>(memchr(s, '<', static_cast<size_t>(_end - s) * sizeof(char_t)));
+		bool complete = (end != 0);
+
+		if (!end)
+		{
+			// split a run longer than the buffer, but not inside a character reference or a CR LF pair
+			end = _end;
+
+			for (char_t* amp = end - 1; amp > s && amp + 16 > _end; --amp)
+			{
+				if (*amp == ';') break;
+				if (*amp == '&')
+				{
+					end = amp;
+					break;
+				}
+			}
+
+			if (end > s + 1 && end[-1] == '\r') --end;
+		}
+
+		_cur = end;
+
+		// PCDATA outside of the document element is dropped, as in xml_document::load
+		if (_depth == 0) return false;
+
+		if (complete && !(_options & parse_ws_pcdata))
+		{
+			char_t* i = s;
+			while (i < end && PUGI__PULL_IS_CHARTYPE(*i, ct_space)) ++i;
+
+			if (i == end) return false;
+		}
+
+		char_t saved = *end;
+		*end = 0;
+
+		impl::get_strconv_pcdata(_options & ~parse_trim_pcdata)(s);
+
+		_value = s;
+		_value_length = impl::strlength(s);
+
+		*end = saved;
+
+		return true;
+	}
+
+	PUGI__FN xml_pull_event xml_pull_parser::next()
+	{
+		if (_status != status_ok) return pull_error;
+
+		if (_pending_end)
+		{
+			_pending_end = false;
+
+			char_t* top = _stack + _stack_size - 1;
+			while (top > _stack && top[-1] != 0) --top;
+
+			_name = top;
+			_stack_size = static_cast<size_t>(top - _stack);
+			_depth--;
+
+			return pull_end_element;
+		}
+
+		while (true)
+		{
+			if (_cur == _end && !fill())
+			{
+				if (_status != status_ok) return pull_error;
+
+				if (_depth != 0) return fail(status_end_element_mismatch, _cur);
+
+				return pull_end_document;
+			}
+
+			if (*_cur == '<')
+			{
+				char_t* end = find_markup_end();
+
+				if (!end)
+				{
+					// incomplete: read more, and once more at the end of the file for the short ones
+					bool eof = _eof;
+
+					if (fill() || !eof) continue;
+					if (_status != status_ok) return pull_error;
+
+					return fail(status_unrecognized_tag, _cur);
+				}
+
+				char_t* s = _cur;
+				_cur = end;
+
+				if (s[1] == '/') return end_element(s + 2);
+
+				if (s[1] == '!' && memcmp(s + 2, "[CDATA[", 7) == 0)
+				{
+					if (_depth == 0 || !(_options & parse_cdata)) continue;
+
+					if (_options & parse_eol) impl::strconv_cdata(s + 9, 0);
+					else end[-3] = 0;
+
+					_value = s + 9;
+					_value_length = impl::strlength(_value);
+
+					return pull_pcdata;
+				}
+
+				// declaration, processing instructions, comments and DOCTYPE are skipped
+				if (s[1] == '?' || s[1] == '!') continue;
+
+				return start_element(s + 1, end);
+			}
+			else
+			{
+				// in-buffer run without '<': read more first, unless the buffer is already full
+				if (!_eof && memchr(_cur, '<', static_cast<size_t>(_end - _cur) * sizeof(char_t)) == 0 && (_cur != _buffer || static_cast<size_t>(_end - _buffer) < _capacity))
+				{
+					fill();
+					continue;
+				}
+
+				if (pcdata()) return pull_pcdata;
+			}
 		}
-
-		impl::node_output(buffered_writer, _root, indent, flags, 0);
 	}
 
-#ifndef PUGIXML_NO_STL
-	PUGI__FN void xml_document::save(std::basic_ostream<char, std::char_traits<char> >& stream, const char_t* indent, unsigned int flags, xml_encoding encoding) const
+	PUGI__FN const char_t* xml_pull_parser::name() const
 	{
-		xml_writer_stream writer(stream);
-
-		save(writer, indent, flags, encoding);
+		return _name;
 	}
 
-	PUGI__FN void xml_document::save(std::basic_ostream<wchar_t, std::char_traits<wchar_t> >& stream, const char_t* indent, unsigned int flags) const
+	PUGI__FN const char_t** xml_pull_parser::attributes() const
 	{
-		xml_writer_stream writer(stream);
-
-		save(writer, indent, flags, encoding_wchar);
+		return _attributes;
 	}
-#endif
 
-	PUGI__FN bool xml_document::save_file(const char* path_, const char_t* indent, unsigned int flags, xml_encoding encoding) const
+	PUGI__FN const char_t* xml_pull_parser::value() const
 	{
-		FILE* file = fopen(path_, (flags & format_save_file_text) ? "w" : "wb");
-		return impl::save_file_impl(*this, file, indent, flags, encoding);
+		return _value;
 	}
 
-	PUGI__FN bool xml_document::save_file(const wchar_t* path_, const char_t* indent, unsigned int flags, xml_encoding encoding) const
+	PUGI__FN size_t xml_pull_parser::value_length() const
 	{
-		FILE* file = impl::open_file_wide(path_, (flags & format_save_file_text) ? L"w" : L"wb");
-		return impl::save_file_impl(*this, file, indent, flags, encoding);
+		return _value_length;
 	}
 
-	PUGI__FN xml_node xml_document::document_element() const
+	PUGI__FN size_t xml_pull_parser::depth() const
 	{
-		assert(_root);
+		return _depth;
+	}
 
-		for (xml_node_struct* i = _root->first_child; i; i = i->next_sibling)
-			if (PUGI__NODETYPE(i) == node_element)
-				return xml_node(i);
+	PUGI__FN xml_parse_status xml_pull_parser::status() const
+	{
+		return _status;
+	}
 
-		return xml_node();
+	PUGI__FN ptrdiff_t xml_pull_parser::offset() const
+	{
+		return _offset;
 	}
+	#undef PUGI__PULL_IS_CHARTYPE
+#endif
 
 #ifndef PUGIXML_NO_STL
 	PUGI__FN std::string PUGIXML_FUNCTION as_utf8(const wchar_t* str)
@@ -6249,6 +8121,18 @@ namespace pugi
 	{
 		return impl::xml_memory::deallocate;
 	}
+
+	PUGI__FN xml_simd PUGIXML_FUNCTION set_simd_scanning(xml_simd simd)
+	{
+		impl::xml_scan::simd = impl::scan_select(simd);
+
+		return impl::xml_scan::simd;
+	}
+
+	PUGI__FN xml_simd PUGIXML_FUNCTION get_simd_scanning()
+	{
+		return impl::xml_scan::simd;
+	}
 }
 
 #if !defined(PUGIXML_NO_STL) && (defined(_MSC_VER) || defined(__ICC))
@@ -7022,6 +8906,14 @@ PUGI__NS_BEGIN
 		return node_is_before_sibling(ln, rn);
 	}
 
+	// Preorder number of the node if its document has an element index
+	PUGI__FN const xml_element_index::label* node_label(xml_node_struct* node)
+	{
+		const xml_element_index* index = get_document(node).element_index;
+
+		return index ? element_index_label(index, node) : 0;
+	}
+
 	PUGI__FN bool node_is_ancestor(xml_node_struct* parent, xml_node_struct* node)
 	{
 		while (node && node != parent) node = node->parent;
@@ -7109,6 +9001,11 @@ PUGI__NS_BEGIN
 			if (ln == rn) return false;
 
 			if (!ln || !rn) return ln < rn;
+
+			const xml_element_index::label* ll = node_label(ln.internal_object());
+			const xml_element_index::label* rl = ll ? node_label(rn.internal_object()) : 0;
+
+			if (rl) return ll->pre < rl->pre;
 			
 			return node_is_before(ln.internal_object(), rn.internal_object());
 		}
@@ -7758,6 +9655,114 @@ PUGI__NS_BEGIN
 		return first ? xpath_node_set::type_sorted : xpath_node_set::type_sorted_reverse;
 	}
 
+	struct xpath_radix_entry
+	{
+		uint64_t key;
+		xpath_node node;
+	};
+
+	// Document order key of a node: its position in the document buffer, or its preorder number (see xpath_sort_radix)
+	PUGI__FN bool xpath_order_key(const xpath_node& xnode, bool labels, uint64_t& key)
+	{
+		if (!labels)
+		{
+			const void* order = document_buffer_order(xnode);
+
+			key = reinterpret_cast<uintptr_t>(order);
+
+			return order != 0;
+		}
+
+		xml_node_struct* node = xnode.node() ? xnode.node().internal_object() : xnode.parent().internal_object();
+		if (!node) return false;
+
+		const xml_element_index::label* l = node_label(node);
+		if (!l) return false;
+
+		// attributes go after their element and before its children, in their order
+		size_t position = 0;
+
+		if (xnode.attribute())
+		{
+			position = 1;
+
+			for (xml_attribute_struct* a = node->first_attribute; a && a != xnode.attribute().internal_object(); a = a->next_attribute)
+				if (++position == 0xfffff) return false;
+		}
+
+		key = (static_cast<uint64_t>(l->pre) << 20) | position;
+
+		return true;
+	}
+
+	// Sorts in document order by radix sort on integer keys instead of comparing nodes; the keys are
+	// the buffer positions if the document was parsed in place and not changed since, otherwise the
+	// preorder numbers of the element index. Returns false (and leaves the set alone) if there are no keys.
+	PUGI__FN bool xpath_sort_radix(xpath_node* begin, xpath_node* end)
+	{
+		size_t size = static_cast<size_t>(end - begin);
+
+		xpath_radix_entry* entries = static_cast<xpath_radix_entry*>(xml_memory::allocate(2 * size * sizeof(xpath_radix_entry)));
+		if (!entries) return false;
+
+		xpath_radix_entry* from = entries;
+		xpath_radix_entry* to = entries + size;
+
+		bool keyed = false;
+
+		for (int labels = 0; labels < 2 && !keyed; ++labels)
+		{
+			keyed = true;
+
+			for (size_t i = 0; i < size && keyed; ++i)
+			{
+				from[i].node = begin[i];
+				keyed = xpath_order_key(begin[i], labels != 0, from[i].key);
+			}
+		}
+
+		if (!keyed)
+		{
+			xml_memory::deallocate(entries);
+			return false;
+		}
+
+		// least significant byte first, skipping the bytes that are the same in all keys
+		size_t counts[8][256] = {};
+
+		for (size_t i = 0; i < size; ++i)
+			for (int b = 0; b < 8; ++b)
+				counts[b][(from[i].key >> (8 * b)) & 0xff]++;
+
+		for (int b = 0; b < 8; ++b)
+		{
+			if (counts[b][(from[0].key >> (8 * b)) & 0xff] == size) continue;
+
+			size_t offset = 0;
+
+			for (int d = 0; d < 256; ++d)
+			{
+				size_t c = counts[b][d];
+				counts[b][d] = offset;
+				offset += c;
+			}
+
+			for (size_t i = 0; i < size; ++i)
+				to[counts[b][(from[i].key >> (8 * b)) & 0xff]++] = from[i];
+
+			xpath_radix_entry* t = from;
+			from = to;
+			to = t;
+		}
+
+		for (size_t i = 0; i < size; ++i)
+			begin[i] = from[i].node;
+
+		xml_memory::deallocate(entries);
+
+		return true;
+	}
+
 	PUGI__FN xpath_node_set::type_t xpath_sort(xpath_node* begin, xpath_node* end, xpath_node_set::type_t type, bool rev)
 	{
 		xpath_node_set::type_t order = rev ? xpath_node_set::type_sorted_reverse : xpath_node_set::type_sorted;
@@ -7768,7 +9773,9 @@ PUGI__NS_BEGIN
 
 			if (sorted == xpath_node_set::type_unsorted)
 			{
-				sort(begin, end, document_order_comparator());
+				// small sets are not worth the key extraction
+				if (end - begin < 64 || !xpath_sort_radix(begin, end))
+					sort(begin, end, document_order_comparator());
 
 				type = xpath_node_set::type_sorted;
 			}
@@ -8408,6 +10415,14 @@ PUGI__NS_BEGIN
 
 	template <axis_t N> const axis_t axis_to_type<N>::axis = N;
 		
+	// What step_fill needs besides the node set being filled
+	struct xpath_step_context
+	{
+		xpath_allocator* alloc;
+		const char_t* atom; // the name of a name test as an atom of the document, 0 if the document does not have it
+		bool atoms; // the names of the document are all interned, so a name test is a pointer comparison with atom
+	};
+
 	class xpath_ast_node
 	{
 	private:
@@ -8711,7 +10726,7 @@ PUGI__NS_BEGIN
 				pred->apply_predicate(ns, first, stack, !pred->_next && last_once);
 		}
 
-		bool step_push(xpath_node_set_raw& ns, xml_attribute_struct* a, xml_node_struct* parent, xpath_allocator* alloc)
+		template <class S> bool step_push(S& ns, xml_attribute_struct* a, xml_node_struct* parent, const xpath_step_context& sc)
 		{
 			assert(a);
 
@@ -8720,9 +10735,9 @@ PUGI__NS_BEGIN
 			switch (_test)
 			{
 			case nodetest_name:
-				if (strequal(name, _data.nodetest) && is_xpath_attribute(name))
+				if ((sc.atoms ? name == sc.atom : strequal(name, _data.nodetest)) && is_xpath_attribute(name))
 				{
-					ns.push_back(xpath_node(xml_attribute(a), xml_node(parent)), alloc);
+					ns.push_back(xpath_node(xml_attribute(a), xml_node(parent)), sc.alloc);
 					return true;
 				}
 				break;
@@ -8731,7 +10746,7 @@ PUGI__NS_BEGIN
 			case nodetest_all:
 				if (is_xpath_attribute(name))
 				{
-					ns.push_back(xpath_node(xml_attribute(a), xml_node(parent)), alloc);
+					ns.push_back(xpath_node(xml_attribute(a), xml_node(parent)), sc.alloc);
 					return true;
 				}
 				break;
@@ -8739,7 +10754,7 @@ PUGI__NS_BEGIN
 			case nodetest_all_in_namespace:
 				if (starts_with(name, _data.nodetest) && is_xpath_attribute(name))
 				{
-					ns.push_back(xpath_node(xml_attribute(a), xml_node(parent)), alloc);
+					ns.push_back(xpath_node(xml_attribute(a), xml_node(parent)), sc.alloc);
 					return true;
 				}
 				break;
@@ -8751,7 +10766,7 @@ PUGI__NS_BEGIN
 			return false;
 		}
 		
-		bool step_push(xpath_node_set_raw& ns, xml_node_struct* n, xpath_allocator* alloc)
+		template <class S> bool step_push(S& ns, xml_node_struct* n, const xpath_step_context& sc)
 		{
 			assert(n);
 
@@ -8760,21 +10775,21 @@ PUGI__NS_BEGIN
 			switch (_test)
 			{
 			case nodetest_name:
-				if (type == node_element && n->name && strequal(n->name, _data.nodetest))
+				if (type == node_element && n->name && (sc.atoms ? n->name == sc.atom : strequal(n->name, _data.nodetest)))
 				{
-					ns.push_back(xml_node(n), alloc);
+					ns.push_back(xml_node(n), sc.alloc);
 					return true;
 				}
 				break;
 				
 			case nodetest_type_node:
-				ns.push_back(xml_node(n), alloc);
+				ns.push_back(xml_node(n), sc.alloc);
 				return true;
 				
 			case nodetest_type_comment:
 				if (type == node_comment)
 				{
-					ns.push_back(xml_node(n), alloc);
+					ns.push_back(xml_node(n), sc.alloc);
 					return true;
 				}
 				break;
@@ -8782,7 +10797,7 @@ PUGI__NS_BEGIN
 			case nodetest_type_text:
 				if (type == node_pcdata || type == node_cdata)
 				{
-					ns.push_back(xml_node(n), alloc);
+					ns.push_back(xml_node(n), sc.alloc);
 					return true;
 				}
 				break;
@@ -8790,7 +10805,7 @@ PUGI__NS_BEGIN
 			case nodetest_type_pi:
 				if (type == node_pi)
 				{
-					ns.push_back(xml_node(n), alloc);
+					ns.push_back(xml_node(n), sc.alloc);
 					return true;
 				}
 				break;
@@ -8798,7 +10813,7 @@ PUGI__NS_BEGIN
 			case nodetest_pi:
 				if (type == node_pi && n->name && strequal(n->name, _data.nodetest))
 				{
-					ns.push_back(xml_node(n), alloc);
+					ns.push_back(xml_node(n), sc.alloc);
 					return true;
 				}
 				break;
@@ -8806,7 +10821,7 @@ PUGI__NS_BEGIN
 			case nodetest_all:
 				if (type == node_element)
 				{
-					ns.push_back(xml_node(n), alloc);
+					ns.push_back(xml_node(n), sc.alloc);
 					return true;
 				}
 				break;
@@ -8814,7 +10829,7 @@ PUGI__NS_BEGIN
 			case nodetest_all_in_namespace:
 				if (type == node_element && n->name && starts_with(n->name, _data.nodetest))
 				{
-					ns.push_back(xml_node(n), alloc);
+					ns.push_back(xml_node(n), sc.alloc);
 					return true;
 				}
 				break;
@@ -8826,7 +10841,7 @@ PUGI__NS_BEGIN
 			return false;
 		}
 
-		template <class T> void step_fill(xpath_node_set_raw& ns, xml_node_struct* n, xpath_allocator* alloc, bool once, T)
+		template <class S, class T> void step_fill(S& ns, xml_node_struct* n, const xpath_step_context& sc, bool once, T)
 		{
 			const axis_t axis = T::axis;
 
@@ -8835,7 +10850,7 @@ PUGI__NS_BEGIN
 			case axis_attribute:
 			{
 				for (xml_attribute_struct* a = n->first_attribute; a; a = a->next_attribute)
-					if (step_push(ns, a, n, alloc) & once)
+					if (step_push(ns, a, n, sc) & once)
 						return;
 				
 				break;
@@ -8844,7 +10859,7 @@ PUGI__NS_BEGIN
 			case axis_child:
 			{
 				for (xml_node_struct* c = n->first_child; c; c = c->next_sibling)
-					if (step_push(ns, c, alloc) & once)
+					if (step_push(ns, c, sc) & once)
 						return;
 					
 				break;
@@ -8854,14 +10869,14 @@ PUGI__NS_BEGIN
 			case axis_descendant_or_self:
 			{
 				if (axis == axis_descendant_or_self)
-					if (step_push(ns, n, alloc) & once)
+					if (step_push(ns, n, sc) & once)
 						return;
 					
 				xml_node_struct* cur = n->first_child;
 				
 				while (cur)
 				{
-					if (step_push(ns, cur, alloc) & once)
+					if (step_push(ns, cur, sc) & once)
 						return;
 					
 					if (cur->first_child)
@@ -8885,7 +10900,7 @@ PUGI__NS_BEGIN
 			case axis_following_sibling:
 			{
 				for (xml_node_struct* c = n->next_sibling; c; c = c->next_sibling)
-					if (step_push(ns, c, alloc) & once)
+					if (step_push(ns, c, sc) & once)
 						return;
 				
 				break;
@@ -8894,7 +10909,7 @@ PUGI__NS_BEGIN
 			case axis_preceding_sibling:
 			{
 				for (xml_node_struct* c = n->prev_sibling_c; c->next_sibling; c = c->prev_sibling_c)
-					if (step_push(ns, c, alloc) & once)
+					if (step_push(ns, c, sc) & once)
 						return;
 				
 				break;
@@ -8916,7 +10931,7 @@ PUGI__NS_BEGIN
 
 				while (cur)
 				{
-					if (step_push(ns, cur, alloc) & once)
+					if (step_push(ns, cur, sc) & once)
 						return;
 
 					if (cur->first_child)
@@ -8958,7 +10973,7 @@ PUGI__NS_BEGIN
 					else
 					{
 						// leaf node, can't be ancestor
-						if (step_push(ns, cur, alloc) & once)
+						if (step_push(ns, cur, sc) & once)
 							return;
 
 						while (!cur->prev_sibling_c->next_sibling)
@@ -8968,7 +10983,7 @@ PUGI__NS_BEGIN
 							if (!cur) return;
 
 							if (!node_is_ancestor(cur, n))
-								if (step_push(ns, cur, alloc) & once)
+								if (step_push(ns, cur, sc) & once)
 									return;
 						}
 
@@ -8983,14 +10998,14 @@ PUGI__NS_BEGIN
 			case axis_ancestor_or_self:
 			{
 				if (axis == axis_ancestor_or_self)
-					if (step_push(ns, n, alloc) & once)
+					if (step_push(ns, n, sc) & once)
 						return;
 
 				xml_node_struct* cur = n->parent;
 				
 				while (cur)
 				{
-					if (step_push(ns, cur, alloc) & once)
+					if (step_push(ns, cur, sc) & once)
 						return;
 					
 					cur = cur->parent;
@@ -9001,7 +11016,7 @@ PUGI__NS_BEGIN
 
 			case axis_self:
 			{
-				step_push(ns, n, alloc);
+				step_push(ns, n, sc);
 
 				break;
 			}
@@ -9009,7 +11024,7 @@ PUGI__NS_BEGIN
 			case axis_parent:
 			{
 				if (n->parent)
-					step_push(ns, n->parent, alloc);
+					step_push(ns, n->parent, sc);
 
 				break;
 			}
@@ -9019,7 +11034,7 @@ PUGI__NS_BEGIN
 			}
 		}
 		
-		template <class T> void step_fill(xpath_node_set_raw& ns, xml_attribute_struct* a, xml_node_struct* p, xpath_allocator* alloc, bool once, T v)
+		template <class S, class T> void step_fill(S& ns, xml_attribute_struct* a, xml_node_struct* p, const xpath_step_context& sc, bool once, T v)
 		{
 			const axis_t axis = T::axis;
 
@@ -9029,14 +11044,14 @@ PUGI__NS_BEGIN
 			case axis_ancestor_or_self:
 			{
 				if (axis == axis_ancestor_or_self && _test == nodetest_type_node) // reject attributes based on principal node type test
-					if (step_push(ns, a, p, alloc) & once)
+					if (step_push(ns, a, p, sc) & once)
 						return;
 
 				xml_node_struct* cur = p;
 				
 				while (cur)
 				{
-					if (step_push(ns, cur, alloc) & once)
+					if (step_push(ns, cur, sc) & once)
 						return;
 					
 					cur = cur->parent;
@@ -9049,7 +11064,7 @@ PUGI__NS_BEGIN
 			case axis_self:
 			{
 				if (_test == nodetest_type_node) // reject attributes based on principal node type test
-					step_push(ns, a, p, alloc);
+					step_push(ns, a, p, sc);
 
 				break;
 			}
@@ -9074,7 +11089,7 @@ PUGI__NS_BEGIN
 						cur = cur->next_sibling;
 					}
 
-					if (step_push(ns, cur, alloc) & once)
+					if (step_push(ns, cur, sc) & once)
 						return;
 				}
 
@@ -9083,7 +11098,7 @@ PUGI__NS_BEGIN
 
 			case axis_parent:
 			{
-				step_push(ns, p, alloc);
+				step_push(ns, p, sc);
 
 				break;
 			}
@@ -9091,7 +11106,7 @@ PUGI__NS_BEGIN
 			case axis_preceding:
 			{
 				// preceding:: axis does not include attribute nodes and attribute ancestors (they are the same as parent's ancestors), so we can reuse node preceding
-				step_fill(ns, p, alloc, once, v);
+				step_fill(ns, p, sc, once, v);
 				break;
 			}
 			
@@ -9100,15 +11115,35 @@ PUGI__NS_BEGIN
 			}
 		}
 
-		template <class T> void step_fill(xpath_node_set_raw& ns, const xpath_node& xn, xpath_allocator* alloc, bool once, T v)
+		template <class S, class T> void step_fill(S& ns, const xpath_node& xn, const xpath_step_context& sc, bool once, T v)
 		{
 			const axis_t axis = T::axis;
 			const bool axis_has_attributes = (axis == axis_ancestor || axis == axis_ancestor_or_self || axis == axis_descendant_or_self || axis == axis_following || axis == axis_parent || axis == axis_preceding || axis == axis_self);
 
 			if (xn.node())
-				step_fill(ns, xn.node().internal_object(), alloc, once, v);
+				step_fill(ns, xn.node().internal_object(), sc, once, v);
 			else if (axis_has_attributes && xn.attribute() && xn.parent())
-				step_fill(ns, xn.attribute().internal_object(), xn.parent().internal_object(), alloc, once, v);
+				step_fill(ns, xn.attribute().internal_object(), xn.parent().internal_object(), sc, once, v);
+		}
+
+		xpath_step_context step_context(const xpath_node& xn, xpath_allocator* alloc) const
+		{
+			xpath_step_context sc = {alloc, 0, false};
+
+			xml_node_struct* node = xn.node() ? xn.node().internal_object() : xn.parent().internal_object();
+
+			if (node && _test == nodetest_name)
+			{
+				const xml_string_atoms* atoms = get_document(node).atoms;
+
+				if (atoms && atoms->complete)
+				{
+					sc.atom = string_atoms_find(atoms, _data.nodetest);
+					sc.atoms = true;
+				}
+			}
+
+			return sc;
 		}
 
 		template <class T> xpath_node_set_raw step_do(const xpath_context& c, const xpath_stack& stack, nodeset_eval_t eval, T v)
@@ -9125,6 +11160,8 @@ PUGI__NS_BEGIN
 			xpath_node_set_raw ns;
 			ns.set_type(axis_type);
 
+			xpath_step_context sc = step_context(c.n, stack.result);
+
 			if (_left)
 			{
 				xpath_node_set_raw s = _left->eval_node_set(c, stack, nodeset_eval_all);
@@ -9139,13 +11176,13 @@ PUGI__NS_BEGIN
 					// in general, all axes generate elements in a particular order, but there is no order guarantee if axis is applied to two nodes
 					if (axis != axis_self && size != 0) ns.set_type(xpath_node_set::type_unsorted);
 					
-					step_fill(ns, *it, stack.result, once, v);
+					step_fill(ns, *it, sc, once, v);
 					if (_right) apply_predicates(ns, size, stack, eval);
 				}
 			}
 			else
 			{
-				step_fill(ns, c.n, stack.result, once, v);
+				step_fill(ns, c.n, sc, once, v);
 				if (_right) apply_predicates(ns, 0, stack, eval);
 			}
 
@@ -9156,6 +11193,143 @@ PUGI__NS_BEGIN
 
 			return ns;
 		}
+
+		// Stands in for xpath_node_set_raw in step_fill when only the number of nodes is needed;
+		// each node goes through the (position invariant) predicates of the step and is dropped
+		class step_counter
+		{
+			xpath_ast_node* _predicates;
+			const xpath_stack& _stack;
+			size_t _count;
+
+		public:
+			step_counter(xpath_ast_node* predicates, const xpath_stack& stack): _predicates(predicates), _stack(stack), _count(0)
+			{
+			}
+
+			void push_back(const xpath_node& node, xpath_allocator*)
+			{
+				xpath_context c(node, 1, 1);
+
+				for (xpath_ast_node* pred = _predicates; pred; pred = pred->_next)
+					if (!pred->_right->eval_boolean(c, _stack))
+						return;
+
+				++_count;
+			}
+
+			size_t size() const
+			{
+				return _count;
+			}
+		};
+
+		template <class T> size_t step_count(const xpath_context& c, const xpath_stack& stack, T v)
+		{
+			const axis_t axis = T::axis;
+
+			// attribute names are unique, so a name test matches at most once
+			bool once = (axis == axis_attribute && _test == nodetest_name);
+
+			step_counter counter(_right, stack);
+
+			xpath_step_context sc = step_context(c.n, stack.result);
+
+			if (_left)
+			{
+				xpath_node_set_raw s = _left->eval_node_set(c, stack, nodeset_eval_all);
+
+				for (const xpath_node* it = s.begin(); it != s.end(); ++it)
+					step_fill(counter, *it, sc, once, v);
+			}
+			else
+				step_fill(counter, c.n, sc, once, v);
+
+			return counter.size();
+		}
+
+		// Elements of a //name or //name[1] step applied to the document, from the element index of the document if it has one
+		bool step_index_lookup(const xpath_context& c, xml_node_struct**& nodes, size_t& size) const
+		{
+			if (_type != ast_step || _test != nodetest_name) return false;
+
+			const xpath_ast_node* from = _left;
+
+			if (_axis == axis_child)
+			{
+				// //name[1] is not rewritten to descendant::name (it is not the same node set), the step is still under descendant-or-self::node()
+				if (!_right || _right->_next || _right->_test != predicate_constant_one) return false;
+				if (!from || from->_type != ast_step || from->_axis != axis_descendant_or_self || from->_test != nodetest_type_node || from->_right) return false;
+
+				from = from->_left;
+			}
+			else if (_axis != axis_descendant)
+				return false;
+
+			xml_node_struct* context = c.n.node() ? c.n.node().internal_object() : c.n.parent().internal_object();
+			if (!context) return false;
+
+			if (from ? from->_type != ast_step_root : PUGI__NODETYPE(context) != node_document) return false;
+
+			const xml_element_index* index = get_document(context).element_index;
+			if (!index) return false;
+
+			const xml_element_index::entry* e = element_index_find(index, _data.nodetest);
+
+			nodes = e ? e->nodes : 0;
+			size = e ? e->size : 0;
+
+			return true;
+		}
+
+		static bool has_previous_sibling_named(xml_node_struct* n)
+		{
+			for (xml_node_struct* c = n->prev_sibling_c; c->next_sibling; c = c->prev_sibling_c)
+				if (PUGI__NODETYPE(c) == node_element && c->name && strequal(c->name, n->name))
+					return true;
+
+			return false;
+		}
+
+		xpath_node_set_raw step_do_indexed(const xpath_stack& stack, nodeset_eval_t eval, xml_node_struct** nodes, size_t size)
+		{
+			// //name[1]: the elements that are the first of their name among their siblings
+			bool first_of_name = (_axis == axis_child);
+			bool once = (!_right || first_of_name) && eval_once(xpath_node_set::type_sorted, eval);
+
+			xpath_node_set_raw ns;
+			ns.set_type(xpath_node_set::type_sorted);
+
+			for (size_t i = 0; i < size; ++i)
+			{
+				if (first_of_name && has_previous_sibling_named(nodes[i])) continue;
+
+				ns.push_back(xml_node(nodes[i]), stack.result);
+
+				if (once) break;
+			}
+
+			if (_right && !first_of_name) apply_predicates(ns, 0, stack, eval);
+
+			return ns;
+		}
+
+		bool is_countable_step() const
+		{
+			if (_type != ast_step) return false;
+
+			for (xpath_ast_node* pred = _right; pred; pred = pred->_next)
+				if (pred->_test != predicate_posinv)
+					return false;
+
+			// child, attribute and self axes never give the same node for two different nodes;
+			// the other forward axes are unique only when applied to a single node
+			if (_axis == axis_child || _axis == axis_attribute || _axis == axis_self)
+				return true;
+
+			return (_axis == axis_descendant || _axis == axis_descendant_or_self || _axis == axis_following || _axis == axis_following_sibling) &&
+				(!_left || _left->_type == ast_step_root);
+		}
 		
 	public:
 		xpath_ast_node(ast_type_t type, xpath_value_type rettype_, const char_t* value):
@@ -9764,6 +11938,57 @@ PUGI__NS_BEGIN
 			}
 		}
 
+		// Number of nodes of the node set, without storing or sorting them when the last step allows it
+		size_t eval_count(const xpath_context& c, const xpath_stack& stack)
+		{
+			xml_node_struct** nodes;
+			size_t size;
+
+			if (_axis == axis_descendant && is_countable_step() && step_index_lookup(c, nodes, size))
+			{
+				if (!_right) return size;
+
+				step_counter counter(_right, stack);
+
+				for (size_t i = 0; i < size; ++i)
+					counter.push_back(xml_node(nodes[i]), stack.result);
+
+				return counter.size();
+			}
+
+			if (is_countable_step())
+			{
+				switch (_axis)
+				{
+				case axis_attribute:
+					return step_count(c, stack, axis_to_type<axis_attribute>());
+
+				case axis_child:
+					return step_count(c, stack, axis_to_type<axis_child>());
+
+				case axis_descendant:
+					return step_count(c, stack, axis_to_type<axis_descendant>());
+
+				case axis_descendant_or_self:
+					return step_count(c, stack, axis_to_type<axis_descendant_or_self>());
+
+				case axis_following:
+					return step_count(c, stack, axis_to_type<axis_following>());
+
+				case axis_following_sibling:
+					return step_count(c, stack, axis_to_type<axis_following_sibling>());
+
+				case axis_self:
+					return step_count(c, stack, axis_to_type<axis_self>());
+
+				default:
+					assert(!"Unknown axis");
+				}
+			}
+
+			return eval_node_set(c, stack, nodeset_eval_all).size();
+		}
+
 		xpath_node_set_raw eval_node_set(const xpath_context& c, const xpath_stack& stack, nodeset_eval_t eval)
 		{
 			switch (_type)
@@ -9805,6 +12030,12 @@ PUGI__NS_BEGIN
 			
 			case ast_step:
 			{
+				xml_node_struct** nodes;
+				size_t size;
+
+				if (step_index_lookup(c, nodes, size))
+					return step_do_indexed(stack, eval, nodes, size);
+
 				switch (_axis)
 				{
 				case axis_ancestor:
@@ -11435,6 +13666,36 @@ namespace pugi
 		return r.first();
 	}
 
+	PUGI__FN size_t xpath_query::evaluate_count(const xpath_node& n) const
+	{
+		impl::xpath_ast_node* root = impl::evaluate_node_set_prepare(static_cast<impl::xpath_query_impl*>(_impl));
+		if (!root) return 0;
+
+		impl::xpath_context c(n, 1, 1);
+		impl::xpath_stack_data sd;
+
+	#ifdef PUGIXML_NO_EXCEPTIONS
+		if (setjmp(sd.error_handler)) return 0;
+	#endif
+
+		return root->eval_count(c, sd.stack);
+	}
+
+	PUGI__FN bool xpath_query::evaluate_exists(const xpath_node& n) const
+	{
+		impl::xpath_ast_node* root = impl::evaluate_node_set_prepare(static_cast<impl::xpath_query_impl*>(_impl));
+		if (!root) return false;
+
+		impl::xpath_context c(n, 1, 1);
+		impl::xpath_stack_data sd;
+
+	#ifdef PUGIXML_NO_EXCEPTIONS
+		if (setjmp(sd.error_handler)) return false;
+	#endif
+
+		return !root->eval_node_set(c, sd.stack, impl::nodeset_eval_any).empty();
+	}
+
 	PUGI__FN const xpath_parse_result& xpath_query::result() const
 	{
 		return _result;
@@ -158,6 +158,15 @@ namespace pugi
 	// is a valid document. This flag is off by default.
 	const unsigned int parse_fragment = 0x1000;
 
+	// This flag determines if element and attribute names are interned: all the occurrences of a name point to the same string, so that
+	// XPath name tests are pointer comparisons. The names then no longer give the position of the nodes in the buffer. This flag is off by default.
+	const unsigned int parse_intern_names = 0x2000;
+
+	// This flag determines if short attribute values and PCDATA/CDATA values (up to 64 characters) are interned the same way, so that
+	// repeated values (ids of codelists, units, reference systems) are stored once. The values then no longer give the position of the
+	// nodes in the buffer. This flag is off by default.
+	const unsigned int parse_intern_values = 0x4000;
+
 	// The default parsing mode.
 	// Elements, PCDATA and CDATA sections are added to the DOM tree, character/reference entities are expanded,
 	// End-of-Line characters are normalized, attribute values are normalized using CDATA normalization rules.
@@ -522,6 +531,13 @@ namespace pugi
 		// Note: append_buffer allocates memory that has the lifetime of the owning document; removing the appended nodes does not immediately reclaim that memory.
 		xml_parse_result append_buffer(const void* contents, size_t size, unsigned int options = parse_default, xml_encoding encoding = encoding_auto);
 
+		// Check if the content of the element was deferred by the parse filter; it is then the value of the element, as text
+		bool deferred() const;
+
+		// Parses the deferred content of the element into its children, with the options of the load that deferred it.
+		// The content is only checked for well-formedness now. Does nothing if the content is not deferred.
+		xml_parse_result expand();
+
 		// Find attribute using predicate. Returns first attribute for which predicate returned true.
 		template <typename Predicate> xml_attribute find_attribute(Predicate pred) const
 		{
@@ -880,6 +896,27 @@ namespace pugi
 		virtual bool end(xml_node& node);
 	};
 
+	// What the parser does with an element, as decided by xml_parse_filter
+	enum xml_filter_result
+	{
+		filter_skip,		// Leave out the element and its whole subtree
+		filter_keep,		// Add the element and parse its content
+		filter_defer		// Add the element, but keep its content unparsed until xml_node::expand()
+	};
+
+	// Abstract parse filter class (see xml_document::set_parse_filter)
+	class PUGIXML_CLASS xml_parse_filter
+	{
+	public:
+		virtual ~xml_parse_filter();
+
+		// Callback that is called for each start tag before the element is added to the tree (the name is not zero-terminated)
+		virtual xml_filter_result element(const char_t* name, size_t length) = 0;
+
+		// Callback that is called for each start tag inside a subtree that is left out, in document order
+		virtual void skipped(const char_t* name, size_t length);
+	};
+
 	// Parsing status, returned as part of xml_parse_result object
 	enum xml_parse_status
 	{
@@ -904,7 +941,9 @@ namespace pugi
 
 		status_append_invalid_root,	// Unable to append nodes since root type is not node_element or node_document (exclusive to xml_node::append_buffer)
 
-		status_no_document_element	// Parsing resulted in a document without element nodes
+		status_no_document_element,	// Parsing resulted in a document without element nodes
+
+		status_unsupported_encoding	// The document is in an encoding the parser does not read (xml_pull_parser reads UTF-8 only)
 	};
 
 	// Parsing result
@@ -929,13 +968,30 @@ namespace pugi
 		const char* description() const;
 	};
 
+	// Memory statistics of the names interned with parse_intern_names and of the values interned with parse_intern_values
+	struct xml_intern_stats
+	{
+		size_t names;				// element and attribute names pointing to a shared string
+		size_t name_bytes;			// bytes of these names as separate strings
+		size_t unique_name_bytes;	// bytes of the shared strings
+		size_t table_bytes;			// bytes of the table finding the shared strings
+		size_t unique_names;		// number of shared strings
+
+		size_t values;				// same for the short attribute and text values (parse_intern_values)
+		size_t value_bytes;
+		size_t unique_value_bytes;
+		size_t value_table_bytes;	// largest size of the table, which is released once the document is loaded
+		size_t unique_values;
+	};
+
 	// Document class (DOM tree root)
 	class PUGIXML_CLASS xml_document: public xml_node
 	{
 	private:
 		char_t* _buffer;
+		xml_parse_filter* _filter;
 
-		char _memory[192];
+		char _memory[232];
 		
 		// Non-copyable semantics
 		xml_document(const xml_document&);
@@ -999,8 +1055,109 @@ namespace pugi
 
 		// Get document element
 		xml_node document_element() const;
+
+		// Build an index of the elements by name, so that XPath answers //name and //name[1] from the document root without traversing the document.
+		// If nodes were moved or buffers appended, the index also numbers the nodes in document order, so that XPath sorts node sets on these numbers.
+		// The index is dropped when the document changes. Returns the memory used by the index in bytes, or 0 if out of memory.
+		size_t build_element_index();
+
+		// Get the memory used by the element index in bytes, 0 if there is none
+		size_t element_index_memory() const;
+
+		// Get the statistics of the names and values interned with parse_intern_names/parse_intern_values
+		xml_intern_stats intern_stats() const;
+
+		// Set the filter deciding which elements the following loads add to the tree, or 0 for all of them.
+		// The subtrees left out and the deferred contents are only scanned for their start and end tags: they are not checked
+		// for well-formedness (a deferred content is checked when it is expanded). The filter is not owned by the document and has to outlive the loads.
+		void set_parse_filter(xml_parse_filter* filter);
+	};
+
+#ifndef PUGIXML_WCHAR_MODE
+	// Events reported by xml_pull_parser
+	enum xml_pull_event
+	{
+		pull_error,				// Parsing failed, see status() and offset()
+		pull_end_document,		// Input is exhausted and all elements are closed
+		pull_start_element,		// Start tag, see name() and attributes()
+		pull_end_element,		// End tag, or the end of an empty-element tag; see name()
+		pull_pcdata				// Character data (PCDATA or CDATA), see value(); long runs are delivered in several pieces
 	};
 
+	// Forward-only pull tokenizer over a file, for documents too big to be loaded as a DOM.
+	// Works in a sliding buffer of fixed size (grown only for a single tag that does not fit in it), so memory
+	// depends on the buffer size and the nesting depth, not on the file size. Uses the same character tables and
+	// string conversions as xml_document::load; only UTF-8 input is supported.
+	// Strings returned by name(), attributes() and value() are valid until the next call to next().
+	class PUGIXML_CLASS xml_pull_parser
+	{
+	private:
+		void* _file;
+		unsigned int _options;
+
+		char_t* _buffer;
+		size_t _capacity;
+		char_t* _cur;
+		char_t* _end;
+		bool _eof;
+		size_t _consumed;
+
+		char_t* _stack;			// names of the open elements, zero-separated
+		size_t _stack_size;
+		size_t _stack_capacity;
+		size_t _depth;
+		bool _pending_end;
+
+		const char_t** _attributes;	// name/value pairs of the current start tag, zero-terminated
+		size_t _attributes_capacity;
+
+		const char_t* _name;
+		const char_t* _value;
+		size_t _value_length;
+
+		xml_parse_status _status;
+		ptrdiff_t _offset;
+
+		// Non-copyable semantics
+		xml_pull_parser(const xml_pull_parser&);
+		const xml_pull_parser& operator=(const xml_pull_parser&);
+
+		bool fill();
+		char_t* find_markup_end();
+		xml_pull_event fail(xml_parse_status status, const char_t* where);
+		xml_pull_event start_element(char_t* s, char_t* end);
+		xml_pull_event end_element(char_t* s);
+		bool pcdata();
+		bool push(const char_t* name);
+		bool push_attribute(const char_t* name, const char_t* value, size_t& count);
+
+	public:
+		// Buffer size in bytes
+		explicit xml_pull_parser(size_t buffer_size = 1024 * 1024);
+		~xml_pull_parser();
+
+		// Open file; the previous one (if any) is closed. Returns false if the file can't be opened or is not UTF-8
+		bool open(const char* path, unsigned int options = parse_default);
+		void close();
+
+		// Read the next event
+		xml_pull_event next();
+
+		// Current element name, attributes (zero-terminated array of name/value pairs) and character data
+		const char_t* name() const;
+		const char_t** attributes() const;
+		const char_t* value() const;
+		size_t value_length() const;
+
+		// Number of open elements
+		size_t depth() const;
+
+		// Error status and offset in the file (after pull_error)
+		xml_parse_status status() const;
+		ptrdiff_t offset() const;
+	};
+#endif
+
 #ifndef PUGIXML_NO_XPATH
 	// XPath query return type
 	enum xpath_value_type
@@ -1152,6 +1309,18 @@ namespace pugi
 		// If PUGIXML_NO_EXCEPTIONS is defined, returns empty node instead.
 		xpath_node evaluate_node(const xpath_node& n) const;
 
+		// Evaluate expression as node set in the specified context.
+		// Return the number of nodes; when the last step has no positional predicates the nodes are counted as they are found, without storing or sorting them.
+		// If PUGIXML_NO_EXCEPTIONS is not defined, throws xpath_exception on type mismatch and std::bad_alloc on out of memory errors.
+		// If PUGIXML_NO_EXCEPTIONS is defined, returns 0 instead.
+		size_t evaluate_count(const xpath_node& n) const;
+
+		// Evaluate expression as node set in the specified context.
+		// Return true if the node set is not empty; evaluation stops at the first node found.
+		// If PUGIXML_NO_EXCEPTIONS is not defined, throws xpath_exception on type mismatch and std::bad_alloc on out of memory errors.
+		// If PUGIXML_NO_EXCEPTIONS is defined, returns false instead.
+		bool evaluate_exists(const xpath_node& n) const;
+
 		// Get parsing result (used to get compilation errors in PUGIXML_NO_EXCEPTIONS mode)
 		const xpath_parse_result& result() const;
 
@@ -1309,6 +1478,20 @@ namespace pugi
 	// Get current memory management functions
 	allocation_function PUGIXML_FUNCTION get_memory_allocation_function();
 	deallocation_function PUGIXML_FUNCTION get_memory_deallocation_function();
+
+	// Instruction sets the parser may use to scan text
+	enum xml_simd
+	{
+		simd_none,	// One character at a time
+		simd_sse2,	// 16 characters at a time
+		simd_avx2	// 32 characters at a time
+	};
+
+	// Limit the instruction set used to scan text, attribute values and whitespace while parsing. By default the best one the
+	// processor supports is used. Returns the instruction set used from now on, which is lower than the one asked if the processor
+	// (or the build) does not support it. Must not be called while documents are being parsed.
+	xml_simd PUGIXML_FUNCTION set_simd_scanning(xml_simd simd);
+	xml_simd PUGIXML_FUNCTION get_simd_scanning();
 }
 
 #if !defined(PUGIXML_NO_STL) && (defined(_MSC_VER) || defined(__ICC))
@@ -0,0 +1,171 @@
+#include "sketch.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+
+QuantileSketch::QuantileSketch(int k) :
+  _k(k),
+  _count(0),
+  _min(0.0),
+  _max(0.0),
+  _spilled(false),
+  _size(0),
+  _limit(0) {
+}
+
+
+//-- the top level holds k values, each level below 2/3 of the one above
+size_t QuantileSketch::capacity(size_t level) const {
+  size_t depth = _levels.size() - 1 - level;
+  return std::max<size_t>(2, static_cast<size_t>(std::ceil(_k * std::pow(2.0 / 3.0, static_cast<double>(depth)))));
+}
+
+
+void QuantileSketch::add_level() {
+  _levels.push_back(std::vector<double>());
+  _odd.push_back(false);
+  _limit = 0;
+  for (size_t h = 0; h < _levels.size(); h++)
+    _limit += capacity(h);
+}
+
+
+void QuantileSketch::add(double v) {
+  if (_count == 0)
+    _min = _max = v;
+  else {
+    _min = std::min(_min, v);
+    _max = std::max(_max, v);
+  }
+  _count++;
+  if (_spilled == false) {
+    _exact[v]++;
+    if (_exact.size() > static_cast<size_t>(_k))
+      spill();
+    return;
+  }
+  _levels[0].push_back(v);
+  _size++;
+  if (_size > _limit)
+    compress();
+}
+
+
+void QuantileSketch::add_weighted(double v, size_t weight) {
+  //-- one value at level h for each bit h of the weight
+  for (size_t h = 0; weight != 0; h++, weight >>= 1) {
+    if ( (weight & 1) == 0)
+      continue;
+    while (_levels.size() <= h)
+      add_level();
+    _levels[h].push_back(v);
+    _size++;
+  }
+}
+
+
+void QuantileSketch::spill() {
+  _spilled = true;
+  if (_levels.empty() == true)
+    add_level();
+  for (auto& e : _exact)
+    add_weighted(e.first, e.second);
+  _exact.clear();
+  compress();
+}
+
+
+void QuantileSketch::compress() {
+  while (_size > _limit) {
+    for (size_t h = 0; h < _levels.size(); h++) {
+      if (_levels[h].size() < capacity(h))
+        continue;
+      if (h + 1 == _levels.size())
+        add_level();
+      std::vector<double>& l = _levels[h];
+      std::sort(l.begin(), l.end());
+      //-- an odd one out stays at this level; the halves kept alternate so
+      //-- that the errors of successive compactions cancel out
+      size_t n = l.size() & ~size_t(1);
+      for (size_t i = _odd[h] ? 1 : 0; i < n; i += 2)
+        _levels[h + 1].push_back(l[i]);
+      _odd[h] = !_odd[h];
+      _size -= n / 2;
+      if (n < l.size())
+        l[0] = l.back();
+      l.resize(l.size() - n);
+      break;
+    }
+  }
+}
+
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+  if (other._count == 0)
+    return;
+  if (_count == 0) {
+    _min = other._min;
+    _max = other._max;
+  }
+  else {
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+  }
+  _count += other._count;
+  for (auto& e : other._exact)
+    _exact[e.first] += e.second;
+  if ( (_spilled == false) && (other._spilled == false) ) {
+    if (_exact.size() > static_cast<size_t>(_k))
+      spill();
+    return;
+  }
+  if (_spilled == false)
+    spill();
+  else if (other._exact.empty() == false) {
+    for (auto& e : _exact)
+      add_weighted(e.first, e.second);
+    _exact.clear();
+  }
+  for (size_t h = 0; h < other._levels.size(); h++) {
+    while (_levels.size() <= h)
+      add_level();
+    _levels[h].insert(_levels[h].end(), other._levels[h].begin(), other._levels[h].end());
+    _size += other._levels[h].size();
+  }
+  compress();
+}
+
+
+double QuantileSketch::quantile(double q) const {
+  if (_count == 0)
+    return 0.0;
+  if (q <= 0.0)
+    return _min;
+  if (q >= 1.0)
+    return _max;
+  std::vector<std::pair<double, size_t> > weighted;
+  size_t total = 0;
+  if (_spilled == false) {
+    for (auto& e : _exact)
+      weighted.push_back(e);
+  }
+  else {
+    for (size_t h = 0; h < _levels.size(); h++) {
+      for (double v : _levels[h])
+        weighted.push_back(std::make_pair(v, size_t(1) << h));
+    }
+    std::sort(weighted.begin(), weighted.end());
+  }
+  for (auto& w : weighted)
+    total += w.second;
+  //-- the first value whose cumulated weight reaches the rank
+  double rank = q * total;
+  size_t cumulative = 0;
+  for (auto& w : weighted) {
+    cumulative += w.second;
+    if (cumulative >= rank)
+      return w.first;
+  }
+  return _max;
+}
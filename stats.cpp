@@ -0,0 +1,1349 @@
+#include "stats.h"
+#include <algorithm>
+#include <mutex>
+#include <cstdlib>
+#include <cmath>
+
+
+Stats::Stats() :
+  buildingpart_with_id(0),
+  relief_component(0),
+  points(0),
+  implicit_inline(0),
+  implicit_referenced(0),
+  prototypes(0),
+  member_inline(0),
+  member_referenced(0),
+  member_resolved(0) {
+  std::fill(tags, tags + TAG_COUNT, 0);
+  std::fill(&surfaces[0][0], &surfaces[0][0] + SURFACE_TYPES * 5, 0);
+  std::fill(&surface_polygons[0][0], &surface_polygons[0][0] + SURFACE_TYPES * 5, 0);
+  std::fill(&feature_lods[0][0][0], &feature_lods[0][0][0] + FK_COUNT * LA_COUNT * 5, 0);
+  std::fill(feature_implicit, feature_implicit + FK_COUNT, 0);
+  std::fill(feature_with_id, feature_with_id + FK_COUNT, 0);
+  std::fill(feature_with_parts, feature_with_parts + FK_COUNT, 0);
+}
+
+
+void Stats::tally_buildings(size_t tally[BF_COUNT]) const {
+  std::fill(tally, tally + BF_COUNT, 0);
+  for (unsigned int f : building_flags) {
+    for (int bit = 0; f != 0; bit++, f >>= 1)
+      tally[bit] += (f & 1);
+  }
+}
+
+
+void Stats::finish_file() {
+  prototypes += implicit_prototypes.size();
+  std::set<std::string>().swap(implicit_prototypes);
+  member_referenced += member_hrefs.size();
+  for (auto& href : member_hrefs)
+    member_resolved += object_ids.count(href);
+  std::unordered_set<std::string>().swap(object_ids);
+  std::vector<std::string>().swap(member_hrefs);
+}
+
+
+void Stats::merge(const Stats& other) {
+  for (int i = 0; i < TAG_COUNT; i++)
+    tags[i] += other.tags[i];
+  buildingpart_with_id += other.buildingpart_with_id;
+  relief_component += other.relief_component;
+  wall_openings.merge(other.wall_openings);
+  for (int k = 0; k < FK_COUNT; k++) {
+    for (int a = 0; a < LA_COUNT; a++) {
+      for (int lod = 0; lod <= 4; lod++)
+        feature_lods[k][a][lod] += other.feature_lods[k][a][lod];
+    }
+    feature_implicit[k] += other.feature_implicit[k];
+    feature_with_id[k] += other.feature_with_id[k];
+    feature_with_parts[k] += other.feature_with_parts[k];
+  }
+  implicit_inline += other.implicit_inline;
+  implicit_referenced += other.implicit_referenced;
+  implicit_prototypes.insert(other.implicit_prototypes.begin(), other.implicit_prototypes.end());
+  prototypes += other.prototypes;
+  object_ids.insert(other.object_ids.begin(), other.object_ids.end());
+  member_hrefs.insert(member_hrefs.end(), other.member_hrefs.begin(), other.member_hrefs.end());
+  member_inline += other.member_inline;
+  member_referenced += other.member_referenced;
+  member_resolved += other.member_resolved;
+  for (int i = 0; i < SURFACE_TYPES; i++) {
+    for (int lod = 0; lod <= 4; lod++) {
+      surfaces[i][lod] += other.surfaces[i][lod];
+      surface_polygons[i][lod] += other.surface_polygons[i][lod];
+    }
+  }
+  points += other.points;
+  ring_vertices.merge(other.ring_vertices);
+  polygon_rings.merge(other.polygon_rings);
+  building_polygons.merge(other.building_polygons);
+  for (int lod = 1; lod <= 4; lod++)
+    building_polygons_lod[lod].merge(other.building_polygons_lod[lod]);
+  extent.add(other.extent);
+  for (int i = 0; i < EC_COUNT; i++)
+    class_extent[i].add(other.class_extent[i]);
+  declared.add(other.declared);
+  for (int lod = 1; lod <= 4; lod++) {
+    building_volume[lod].merge(other.building_volume[lod]);
+    building_area[lod].merge(other.building_area[lod]);
+  }
+  building_flags.insert(building_flags.end(), other.building_flags.begin(), other.building_flags.end());
+}
+
+
+int feature_kind(Tag t) {
+  switch (t) {
+    case TAG_WATERBODY:
+      return FK_WATERBODY;
+    case TAG_SOLITARYVEGETATIONOBJECT:
+      return FK_SOLITARYVEGETATIONOBJECT;
+    case TAG_PLANTCOVER:
+      return FK_PLANTCOVER;
+    case TAG_TRANSPORTATIONCOMPLEX: case TAG_TRACK: case TAG_RAILWAY: case TAG_ROAD: case TAG_SQUARE:
+      return FK_TRANSPORTATION;
+    case TAG_TRAFFICAREA:
+      return FK_TRAFFICAREA;
+    case TAG_AUXILIARYTRAFFICAREA:
+      return FK_AUXILIARYTRAFFICAREA;
+    case TAG_BRIDGE:
+      return FK_BRIDGE;
+    case TAG_BRIDGEPART:
+      return FK_BRIDGEPART;
+    case TAG_TUNNEL:
+      return FK_TUNNEL;
+    case TAG_TUNNELPART:
+      return FK_TUNNELPART;
+    case TAG_CITYFURNITURE:
+      return FK_CITYFURNITURE;
+    default:
+      return -1;
+  }
+}
+
+
+int extent_class(Tag t) {
+  switch (t) {
+    case TAG_BUILDING:
+      return EC_BUILDING;
+    case TAG_RELIEFFEATURE:
+      return EC_RELIEF;
+    case TAG_LANDUSE:
+      return EC_LANDUSE;
+    case TAG_WATERBODY:
+      return EC_WATER;
+    case TAG_SOLITARYVEGETATIONOBJECT: case TAG_PLANTCOVER:
+      return EC_VEGETATION;
+    case TAG_TRANSPORTATIONCOMPLEX: case TAG_TRACK: case TAG_RAILWAY: case TAG_ROAD: case TAG_SQUARE:
+      return EC_TRANSPORTATION;
+    default:
+      return -1;
+  }
+}
+
+
+//-- the prefix of a module in ns, empty if it is not declared
+static std::string prefix(const std::map<std::string, std::string>& ns, const char* module) {
+  auto it = ns.find(module);
+  return (it == ns.end()) ? std::string() : it->second;
+}
+
+
+//-- the qualified name of every Tag, with the prefixes of this file (looked
+//-- up in a copy, ns may be shared by several threads)
+static void tag_names(const std::map<std::string, std::string>& prefixes, std::vector<std::pair<Tag, std::string> >& l) {
+  std::map<std::string, std::string> ns(prefixes);
+  l.push_back(std::make_pair(TAG_BUILDING,               ns["building"] + "Building"));
+  l.push_back(std::make_pair(TAG_BUILDINGPART,           ns["building"] + "BuildingPart"));
+  l.push_back(std::make_pair(TAG_CONSISTSOFBUILDINGPART, ns["building"] + "consistsOfBuildingPart"));
+  l.push_back(std::make_pair(TAG_BOUNDEDBY,              ns["building"] + "boundedBy"));
+  l.push_back(std::make_pair(TAG_ROOFSURFACE,            ns["building"] + "RoofSurface"));
+  l.push_back(std::make_pair(TAG_WALLSURFACE,            ns["building"] + "WallSurface"));
+  l.push_back(std::make_pair(TAG_GROUNDSURFACE,          ns["building"] + "GroundSurface"));
+  l.push_back(std::make_pair(TAG_CLOSURESURFACE,         ns["building"] + "ClosureSurface"));
+  l.push_back(std::make_pair(TAG_OUTERCEILINGSURFACE,    ns["building"] + "OuterCeilingSurface"));
+  l.push_back(std::make_pair(TAG_OUTERFLOORSURFACE,      ns["building"] + "OuterFloorSurface"));
+  l.push_back(std::make_pair(TAG_DOOR,                   ns["building"] + "Door"));
+  l.push_back(std::make_pair(TAG_WINDOW,                 ns["building"] + "Window"));
+  l.push_back(std::make_pair(TAG_BUILDINGINSTALLATION,   ns["building"] + "BuildingInstallation"));
+  l.push_back(std::make_pair(TAG_INTBUILDINGINSTALLATION, ns["building"] + "IntBuildingInstallation"));
+  l.push_back(std::make_pair(TAG_ROOM,                   ns["building"] + "Room"));
+  l.push_back(std::make_pair(TAG_BUILDINGFURNITURE,      ns["building"] + "BuildingFurniture"));
+  l.push_back(std::make_pair(TAG_LOD0FOOTPRINT,          ns["building"] + "lod0FootPrint"));
+  l.push_back(std::make_pair(TAG_LOD0ROOFEDGE,           ns["building"] + "lod0RoofEdge"));
+  for (int lod = 1; lod <= 4; lod++) {
+    std::string slod = "lod" + std::to_string(lod);
+    l.push_back(std::make_pair(Tag(TAG_LOD1SOLID + lod - 1),               ns["building"] + slod + "Solid"));
+    l.push_back(std::make_pair(Tag(TAG_LOD1MULTISURFACE + lod - 1),        ns["building"] + slod + "MultiSurface"));
+    l.push_back(std::make_pair(Tag(TAG_LOD1TERRAININTERSECTION + lod - 1), ns["building"] + slod + "TerrainIntersection"));
+  }
+  l.push_back(std::make_pair(TAG_SOLID,                    ns["gml"] + "Solid"));
+  l.push_back(std::make_pair(TAG_MULTISOLID,               ns["gml"] + "MultiSolid"));
+  l.push_back(std::make_pair(TAG_COMPOSITESOLID,           ns["gml"] + "CompositeSolid"));
+  l.push_back(std::make_pair(TAG_MULTISURFACE,             ns["gml"] + "MultiSurface"));
+  l.push_back(std::make_pair(TAG_COMPOSITESURFACE,         ns["gml"] + "CompositeSurface"));
+  l.push_back(std::make_pair(TAG_POLYGON,                  ns["gml"] + "Polygon"));
+  l.push_back(std::make_pair(TAG_TRIANGLE,                 ns["gml"] + "Triangle"));
+  l.push_back(std::make_pair(TAG_LINEARRING,               ns["gml"] + "LinearRing"));
+  l.push_back(std::make_pair(TAG_POS,                      ns["gml"] + "pos"));
+  l.push_back(std::make_pair(TAG_POSLIST,                  ns["gml"] + "posList"));
+  l.push_back(std::make_pair(TAG_COORDINATES,              ns["gml"] + "coordinates"));
+  l.push_back(std::make_pair(TAG_ENVELOPE,                 ns["gml"] + "Envelope"));
+  l.push_back(std::make_pair(TAG_LOWERCORNER,              ns["gml"] + "lowerCorner"));
+  l.push_back(std::make_pair(TAG_UPPERCORNER,              ns["gml"] + "upperCorner"));
+  l.push_back(std::make_pair(TAG_RELIEFFEATURE,            ns["dem"] + "ReliefFeature"));
+  l.push_back(std::make_pair(TAG_RELIEFCOMPONENT,          ns["dem"] + "reliefComponent"));
+  l.push_back(std::make_pair(TAG_TINRELIEF,                ns["dem"] + "TINRelief"));
+  l.push_back(std::make_pair(TAG_RASTERRELIEF,             ns["dem"] + "RasterRelief"));
+  l.push_back(std::make_pair(TAG_MASSPOINTRELIEF,          ns["dem"] + "MassPointRelief"));
+  l.push_back(std::make_pair(TAG_BREAKLINERELIEF,          ns["dem"] + "BreaklineRelief"));
+  l.push_back(std::make_pair(TAG_LANDUSE,                  ns["luse"] + "LandUse"));
+  l.push_back(std::make_pair(TAG_SOLITARYVEGETATIONOBJECT, ns["veg"] + "SolitaryVegetationObject"));
+  l.push_back(std::make_pair(TAG_PLANTCOVER,               ns["veg"] + "PlantCover"));
+  l.push_back(std::make_pair(TAG_WATERBODY,                ns["wtr"] + "WaterBody"));
+  l.push_back(std::make_pair(TAG_WATERCLOSURESURFACE,      ns["wtr"] + "WaterClosureSurface"));
+  l.push_back(std::make_pair(TAG_WATERGROUNDSURFACE,       ns["wtr"] + "WaterGroundSurface"));
+  l.push_back(std::make_pair(TAG_WATERSURFACE,             ns["wtr"] + "WaterSurface"));
+  l.push_back(std::make_pair(TAG_APPEARANCE,               ns["app"] + "Appearance"));
+  l.push_back(std::make_pair(TAG_IMPLICITGEOMETRY,         ns["citygml"] + "ImplicitGeometry"));
+  l.push_back(std::make_pair(TAG_RELATIVEGMLGEOMETRY,      ns["citygml"] + "relativeGMLGeometry"));
+  l.push_back(std::make_pair(TAG_LIBRARYOBJECT,            ns["citygml"] + "libraryObject"));
+  l.push_back(std::make_pair(TAG_TRAFFICAREA,              ns["tran"] + "TrafficArea"));
+  l.push_back(std::make_pair(TAG_TRANSPORTATIONCOMPLEX,    ns["tran"] + "TransportationComplex"));
+  l.push_back(std::make_pair(TAG_TRACK,                    ns["tran"] + "Track"));
+  l.push_back(std::make_pair(TAG_RAILWAY,                  ns["tran"] + "Railway"));
+  l.push_back(std::make_pair(TAG_ROAD,                     ns["tran"] + "Road"));
+  l.push_back(std::make_pair(TAG_SQUARE,                   ns["tran"] + "Square"));
+  l.push_back(std::make_pair(TAG_AUXILIARYTRAFFICAREA,     ns["tran"] + "AuxiliaryTrafficArea"));
+  l.push_back(std::make_pair(TAG_BRIDGE,                   ns["brid"] + "Bridge"));
+  l.push_back(std::make_pair(TAG_BRIDGEPART,               ns["brid"] + "BridgePart"));
+  l.push_back(std::make_pair(TAG_CONSISTSOFBRIDGEPART,     ns["brid"] + "consistsOfBridgePart"));
+  l.push_back(std::make_pair(TAG_BRIDGECONSTRUCTIONELEMENT, ns["brid"] + "BridgeConstructionElement"));
+  l.push_back(std::make_pair(TAG_BRIDGEINSTALLATION,       ns["brid"] + "BridgeInstallation"));
+  l.push_back(std::make_pair(TAG_INTBRIDGEINSTALLATION,    ns["brid"] + "IntBridgeInstallation"));
+  l.push_back(std::make_pair(TAG_BRIDGEROOM,               ns["brid"] + "BridgeRoom"));
+  l.push_back(std::make_pair(TAG_TUNNEL,                   ns["tun"] + "Tunnel"));
+  l.push_back(std::make_pair(TAG_TUNNELPART,               ns["tun"] + "TunnelPart"));
+  l.push_back(std::make_pair(TAG_CONSISTSOFTUNNELPART,     ns["tun"] + "consistsOfTunnelPart"));
+  l.push_back(std::make_pair(TAG_TUNNELINSTALLATION,       ns["tun"] + "TunnelInstallation"));
+  l.push_back(std::make_pair(TAG_INTTUNNELINSTALLATION,    ns["tun"] + "IntTunnelInstallation"));
+  l.push_back(std::make_pair(TAG_HOLLOWSPACE,              ns["tun"] + "HollowSpace"));
+  l.push_back(std::make_pair(TAG_CITYFURNITURE,            ns["frn"] + "CityFurniture"));
+  l.push_back(std::make_pair(TAG_CITYOBJECTGROUP,          ns["grp"] + "CityObjectGroup"));
+  l.push_back(std::make_pair(TAG_GROUPMEMBER,              ns["grp"] + "groupMember"));
+  l.push_back(std::make_pair(TAG_GROUPPARENT,              ns["grp"] + "parent"));
+}
+
+
+StatsCollector::StatsCollector(const std::map<std::string, std::string>& ns, int reports, Stats& stats) :
+  _stats(stats),
+  _interned(false),
+  _semantics((reports & REPORT_BUILDING) != 0),
+  _thematic(-1),
+  _thematicdepth(0),
+  _thematiclod(0),
+  _openings(0),
+  _lods((reports & FEATURE_REPORTS & ~REPORT_GROUP) != 0),
+  _groups((reports & REPORT_GROUP) != 0),
+  _geometry(reads_coordinates(reports)),
+  _coordinates(-1),
+  _coordtag(TAG_OTHER),
+  _class(-1),
+  _classdepth(0),
+  _envelope(-1),
+  _declared(false),
+  _measure((reports & REPORT_GEOMETRY) != 0),
+  _shapes((reports & REPORT_PRIMITIVES) != 0),
+  _solidlod(0),
+  _soliddepth(0),
+  _surfacelod(0),
+  _surfacedepth(0),
+  _polygon(-1),
+  _polygonrings(0),
+  _ring(-1),
+  _ringvertices(0) {
+  std::vector<std::pair<Tag, std::string> > l;
+  tag_names(ns, l);
+  //-- keys point into _names, so it must not grow after this
+  _names.reserve(l.size());
+  for (auto& each : l) {
+    _names.push_back(each.second);
+    _tags.insert(std::make_pair(_names.back().c_str(), each.first));
+  }
+  _gmlid = prefix(ns, "gml") + "id";
+  _href = prefix(ns, "xlink") + "href";
+  _gmlboundedby = prefix(ns, "gml") + "boundedBy";
+  _gmlprefix = prefix(ns, "gml");
+}
+
+
+StatsCollector::FeatureFrame::FeatureFrame(int k, size_t d) :
+  kind(k),
+  depth(d),
+  boundedby(0),
+  implicit(false),
+  id(false),
+  parts(false) {
+  std::fill(lods, lods + LA_COUNT, 0);
+}
+
+
+//-- the lodN properties of the object of f (its children), and the
+//-- lodNMultiSurface of its thematic surfaces (below its boundedBy)
+void StatsCollector::feature_property(FeatureFrame& f, const char* name, size_t depth) {
+  bool own = (f.depth + 1 == depth);
+  if ( (own == false) && (f.boundedby == 0) )
+    return;
+  const char* local = std::strchr(name, ':');
+  local = (local != NULL) ? local + 1 : name;
+  if ( (own == true) && (std::strcmp(local, "boundedBy") == 0) && (_gmlboundedby != name) ) {
+    f.boundedby = depth;
+    return;
+  }
+  if ( (std::strncmp(local, "lod", 3) != 0) || (local[3] < '0') || (local[3] > '4') )
+    return;
+  unsigned int bit = 1u << (local[3] - '0');
+  const char* property = local + 4;
+  if (own == false) {
+    if (std::strcmp(property, "MultiSurface") == 0)
+      f.lods[LA_SEMANTICS] |= bit;
+    return;
+  }
+  if (std::strcmp(property, "TerrainIntersection") == 0) {
+    f.lods[LA_TIC] |= bit;
+    return;
+  }
+  f.lods[LA_GEOMETRY] |= bit;
+  if (std::strcmp(property, "Solid") == 0)
+    f.lods[LA_SOLID] |= bit;
+  else if (std::strcmp(property, "MultiSurface") == 0)
+    f.lods[LA_MULTISURFACE] |= bit;
+  else if (std::strcmp(property, "ImplicitRepresentation") == 0)
+    f.implicit = true;
+}
+
+
+Tag StatsCollector::lookup(const char* name) {
+  if (_interned == true) {
+    auto a = _atoms.find(name);
+    if (a != _atoms.end())
+      return a->second;
+  }
+  auto it = _tags.find(name);
+  Tag t = (it == _tags.end()) ? TAG_OTHER : it->second;
+  if (_interned == true)
+    _atoms.insert(std::make_pair(name, t));
+  return t;
+}
+
+
+bool StatsCollector::has_attribute(const char** attrs, const std::string& name) const {
+  for (; *attrs != NULL; attrs += 2) {
+    if (name == *attrs)
+      return true;
+  }
+  return false;
+}
+
+
+const char* StatsCollector::attribute(const char** attrs, const char* name) const {
+  for (; *attrs != NULL; attrs += 2) {
+    if (std::strcmp(*attrs, name) == 0)
+      return attrs[1];
+  }
+  return NULL;
+}
+
+
+void StatsCollector::start_coordinates(Tag t, const char** attrs) {
+  int dimension = _dimensions.empty() ? 0 : _dimensions.back().second;
+  if (t != TAG_COORDINATES)
+    _reader.start_list((dimension > 0) ? dimension : 3);
+  else {
+    const char* cs = attribute(attrs, "cs");
+    const char* ts = attribute(attrs, "ts");
+    const char* decimal = attribute(attrs, "decimal");
+    _reader.start_tuples(dimension, (cs && *cs) ? *cs : ',', (ts && *ts) ? *ts : ' ', (decimal && *decimal) ? *decimal : '.');
+  }
+  _coordinates = _stack.size() - 1;
+  _coordtag = t;
+}
+
+
+void StatsCollector::start_measures(Tag t, size_t depth, const char** attrs) {
+  switch (t) {
+    case TAG_LOD1SOLID: case TAG_LOD2SOLID: case TAG_LOD3SOLID: case TAG_LOD4SOLID:
+      if (_solidlod == 0) {
+        _solidlod = t - TAG_LOD1SOLID + 1;
+        _soliddepth = depth;
+        _geom.solid[_solidlod] = true;
+      }
+      break;
+    case TAG_LOD1MULTISURFACE: case TAG_LOD2MULTISURFACE: case TAG_LOD3MULTISURFACE: case TAG_LOD4MULTISURFACE:
+      if (_surfacelod == 0) {
+        _surfacelod = t - TAG_LOD1MULTISURFACE + 1;
+        _surfacedepth = depth;
+      }
+      break;
+    case TAG_POLYGON: {
+      _polygon = depth;
+      const char* id = attribute(attrs, _gmlid.c_str());
+      _polygonid = (id != NULL) ? id : "";
+      _normal[0] = _normal[1] = _normal[2] = 0.0;
+      _volume6 = 0.0;
+      _polygonrings = 0;
+      break;
+    }
+    case TAG_LINEARRING:
+      _ring = depth;
+      _ringpoints.clear();
+      _ringvertices = 0;
+      break;
+    default:
+      break;
+  }
+  //-- the surfaces of a solid given by reference to polygons elsewhere in the building
+  if ( (_measure == true) && (_solidlod > 0) ) {
+    const char* href = attribute(attrs, _href.c_str());
+    if (href != NULL)
+      _geom.hrefs.push_back(std::make_pair(_solidlod, std::string((*href == '#') ? href + 1 : href)));
+  }
+}
+
+
+void StatsCollector::end_measures(Tag t, size_t depth) {
+  if ( (t == TAG_LINEARRING) && (_ring == (long)depth) ) {
+    //-- the last position of a ring repeats the first
+    if (_shapes == true)
+      _stats.ring_vertices.add((_ringvertices > 0) ? _ringvertices - 1 : 0);
+    if (_polygon >= 0)
+      _polygonrings++;
+    size_t n = _ringpoints.size() / 3;
+    if (n >= 3) {
+      if (_geom.hasorigin == false) {
+        std::copy(_ringpoints.begin(), _ringpoints.begin() + 3, _geom.origin);
+        _geom.hasorigin = true;
+      }
+      _volume6 += ring_measures(_ringpoints.data(), n, _geom.origin, _normal);
+    }
+    _ring = -1;
+  }
+  else if ( (t == TAG_POLYGON) && (_polygon == (long)depth) ) {
+    _polygon = -1;
+    if (_shapes == true)
+      _stats.polygon_rings.add(_polygonrings);
+    if (_buildings.empty() == true)
+      return;
+    _geom.polygoncount[0]++;
+    if (_solidlod > 0)
+      _geom.polygoncount[_solidlod]++;
+    if (_surfacelod > 0)
+      _geom.polygoncount[_surfacelod]++;
+    if (_measure == false)
+      return;
+    PolygonMeasures m;
+    m.area = 0.5 * std::sqrt(_normal[0] * _normal[0] + _normal[1] * _normal[1] + _normal[2] * _normal[2]);
+    m.volume6 = _volume6;
+    if (_solidlod > 0) {
+      _geom.solidarea[_solidlod].add(m.area);
+      _geom.solidvolume6[_solidlod].add(m.volume6);
+    }
+    if (_surfacelod > 0) {
+      _geom.surfacearea[_surfacelod].add(m.area);
+      _geom.surface[_surfacelod] = true;
+    }
+    if (_polygonid.empty() == false)
+      _geom.polygons[_polygonid] = m;
+  }
+  else if ( (_solidlod > 0) && (_soliddepth == depth) )
+    _solidlod = 0;
+  else if ( (_surfacelod > 0) && (_surfacedepth == depth) )
+    _surfacelod = 0;
+}
+
+
+void StatsCollector::end_building_measures() {
+  if (_shapes == true) {
+    _stats.building_polygons.add(_geom.polygoncount[0]);
+    for (int lod = 1; lod <= 4; lod++) {
+      if (_geom.polygoncount[lod] > 0)
+        _stats.building_polygons_lod[lod].add(_geom.polygoncount[lod]);
+    }
+  }
+  if (_measure == false)
+    return;
+  for (auto& h : _geom.hrefs) {
+    auto it = _geom.polygons.find(h.second);
+    if (it != _geom.polygons.end()) {
+      _geom.solidarea[h.first].add(it->second.area);
+      _geom.solidvolume6[h.first].add(it->second.volume6);
+    }
+  }
+  //-- a solid whose polygons are all elsewhere (outside the building) has no measures
+  for (int lod = 1; lod <= 4; lod++) {
+    if ( (_geom.solid[lod] == true) && (_geom.solidarea[lod].value() > 0) ) {
+      _stats.building_volume[lod].add(std::fabs(_geom.solidvolume6[lod].value()) / 6);
+      _stats.building_area[lod].add(_geom.solidarea[lod].value());
+    }
+    else if (_geom.surface[lod] == true)
+      _stats.building_area[lod].add(_geom.surfacearea[lod].value());
+  }
+}
+
+
+void StatsCollector::start_element(const char* name, const char** attrs) {
+  Tag t = lookup(name);
+  size_t depth = _stack.size();
+  Tag parent = (depth > 0) ? _stack.back() : TAG_OTHER;
+  _stack.push_back(t);
+  if ( (_lods == true) && (_features.empty() == false) )
+    feature_property(_features.back(), name, depth);
+  //-- the ids the grp:groupMember may refer to, the gml objects left aside
+  if ( (_groups == true) && ( (_gmlprefix.empty() == true) || (std::strncmp(name, _gmlprefix.c_str(), _gmlprefix.size()) != 0) ) ) {
+    const char* id = attribute(attrs, _gmlid.c_str());
+    if (id != NULL)
+      _stats.object_ids.insert(id);
+  }
+  //-- srsDimension holds for the geometry it is declared on and all below
+  if (_geometry == true) {
+    const char* dim = attribute(attrs, "srsDimension");
+    if (dim != NULL)
+      _dimensions.push_back(std::make_pair(depth, std::atoi(dim)));
+  }
+  if (t == TAG_OTHER) {
+    //-- the references of a solid to its polygons are on the gml:surfaceMember
+    if ( (_measure == true) && (_solidlod > 0) )
+      start_measures(t, depth, attrs);
+    return;
+  }
+  _stats.tags[t]++;
+  if ( (_lods == true) && (feature_kind(t) >= 0) ) {
+    _features.push_back(FeatureFrame(feature_kind(t), depth));
+    _features.back().id = has_attribute(attrs, _gmlid);
+  }
+  if ( (_class < 0) && (extent_class(t) >= 0) ) {
+    _class = extent_class(t);
+    _classdepth = depth;
+  }
+  switch (t) {
+    case TAG_BUILDING: {
+      if ( ( (_measure == true) || (_shapes == true) ) && (_buildings.empty() == true) )
+        _geom = BuildingGeometry();
+      BuildingFrame f = { depth, -1, 0 };
+      if (has_attribute(attrs, _gmlid) == true)
+        f.flags |= 1u << BF_ID;
+      _buildings.push_back(f);
+      break;
+    }
+    case TAG_BUILDINGPART:
+      if (has_attribute(attrs, _gmlid) == true)
+        _stats.buildingpart_with_id++;
+      break;
+    case TAG_CONSISTSOFBUILDINGPART:
+      if (parent == TAG_BUILDING)
+        _buildings.back().flags |= 1u << BF_PART;
+      break;
+    case TAG_BOUNDEDBY:
+      if (parent == TAG_BUILDING)
+        _buildings.back().boundedby = depth;
+      break;
+    case TAG_ROOFSURFACE: case TAG_WALLSURFACE: case TAG_GROUNDSURFACE:
+    case TAG_CLOSURESURFACE: case TAG_OUTERCEILINGSURFACE: case TAG_OUTERFLOORSURFACE:
+      if ( (_semantics == true) && (_thematic < 0) && (_buildings.empty() == false) ) {
+        _thematic = t - TAG_ROOFSURFACE;
+        _thematicdepth = depth;
+        _openings = 0;
+      }
+      break;
+    case TAG_DOOR: case TAG_WINDOW: case TAG_BUILDINGINSTALLATION:
+    case TAG_INTBUILDINGINSTALLATION: case TAG_ROOM: case TAG_BUILDINGFURNITURE:
+      for (auto& b : _buildings)
+        b.flags |= 1u << (BF_DOOR + (t - TAG_DOOR));
+      if ( (t == TAG_DOOR) || (t == TAG_WINDOW) )
+        _openings++;
+      break;
+    case TAG_POLYGON:
+      if (_thematiclod > 0)
+        _stats.surface_polygons[_thematic][_thematiclod]++;
+      break;
+    case TAG_RELATIVEGMLGEOMETRY: {
+      //-- a geometry given once (the prototype) and reused by reference
+      const char* href = attribute(attrs, _href.c_str());
+      if (href == NULL)
+        _stats.implicit_inline++;
+      else {
+        _stats.implicit_referenced++;
+        _stats.implicit_prototypes.insert(href);
+      }
+      break;
+    }
+    case TAG_CONSISTSOFBRIDGEPART: case TAG_CONSISTSOFTUNNELPART:
+      if ( (_lods == true) && ( (parent == TAG_BRIDGE) || (parent == TAG_TUNNEL) ) )
+        _features.back().parts = true;
+      break;
+    case TAG_GROUPMEMBER: {
+      const char* href = attribute(attrs, _href.c_str());
+      if (href == NULL)
+        _stats.member_inline++;
+      else
+        _stats.member_hrefs.push_back((href[0] == '#') ? href + 1 : href);
+      break;
+    }
+    case TAG_RELIEFCOMPONENT:
+      if (parent == TAG_RELIEFFEATURE)
+        _stats.relief_component++;
+      break;
+    case TAG_POS: case TAG_POSLIST: case TAG_COORDINATES:
+      if (_geometry == true)
+        start_coordinates(t, attrs);
+      break;
+    //-- the envelope of the root (root/gml:boundedBy/gml:Envelope) is the one
+    //-- declared for the file; the others are not geometry of their object
+    case TAG_ENVELOPE:
+      if (_envelope < 0) {
+        _envelope = depth;
+        _declared = (depth == 2);
+      }
+      break;
+    case TAG_LOWERCORNER: case TAG_UPPERCORNER:
+      if ( (_geometry == true) && (_envelope >= 0) )
+        start_coordinates(t, attrs);
+      break;
+    case TAG_LOD0FOOTPRINT:
+      for (auto& b : _buildings)
+        b.flags |= 1u << BF_FOOTPRINT;
+      break;
+    case TAG_LOD0ROOFEDGE:
+      for (auto& b : _buildings)
+        b.flags |= 1u << BF_ROOFEDGE;
+      break;
+    case TAG_LOD1SOLID: case TAG_LOD2SOLID: case TAG_LOD3SOLID: case TAG_LOD4SOLID:
+      for (auto& b : _buildings)
+        b.flags |= 1u << bf_solid(t - TAG_LOD1SOLID + 1);
+      break;
+    case TAG_LOD1TERRAININTERSECTION: case TAG_LOD2TERRAININTERSECTION:
+    case TAG_LOD3TERRAININTERSECTION: case TAG_LOD4TERRAININTERSECTION:
+      for (auto& b : _buildings)
+        b.flags |= 1u << bf_tic(t - TAG_LOD1TERRAININTERSECTION + 1);
+      break;
+    case TAG_LOD1MULTISURFACE: case TAG_LOD2MULTISURFACE: case TAG_LOD3MULTISURFACE: case TAG_LOD4MULTISURFACE: {
+      int lod = t - TAG_LOD1MULTISURFACE + 1;
+      for (auto& b : _buildings) {
+        if (b.depth + 1 == depth)
+          b.flags |= 1u << bf_ms(lod);
+        if (b.boundedby >= 0)
+          b.flags |= 1u << bf_sem(lod);
+      }
+      //-- the geometry of the surface itself, not of its openings
+      if ( (_thematic >= 0) && (_thematicdepth + 1 == depth) ) {
+        _thematiclod = lod;
+        _stats.surfaces[_thematic][lod]++;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  if ( (_measure == true) || (_shapes == true) )
+    start_measures(t, depth, attrs);
+}
+
+
+void StatsCollector::end_element() {
+  Tag t = _stack.back();
+  _stack.pop_back();
+  size_t depth = _stack.size();
+  if (_coordinates == (long)depth) {
+    if (_reader.finish() == true) {
+      if (_ring >= 0) {
+        _ringvertices += _reader.points();
+        if ( (_measure == true) && (_polygon >= 0) && (_buildings.empty() == false) && (_reader.dimension() == 3) )
+          _ringpoints.insert(_ringpoints.end(), _reader.values().begin(), _reader.values().end());
+      }
+      if ( (_coordtag != TAG_LOWERCORNER) && (_coordtag != TAG_UPPERCORNER) )
+        _stats.points += _reader.points();
+      if (_envelope < 0) {
+        _stats.extent.add(_reader.values(), _reader.dimension());
+        if (_class >= 0)
+          _stats.class_extent[_class].add(_reader.values(), _reader.dimension());
+      }
+      else if (_declared == true)
+        _stats.declared.add(_reader.values(), _reader.dimension());
+    }
+    _coordinates = -1;
+  }
+  if (_envelope == (long)depth)
+    _envelope = -1;
+  if ( (_class >= 0) && (_classdepth == depth) )
+    _class = -1;
+  if ( (_dimensions.empty() == false) && (_dimensions.back().first == depth) )
+    _dimensions.pop_back();
+  if ( (_measure == true) || (_shapes == true) )
+    end_measures(t, depth);
+  if (_features.empty() == false) {
+    FeatureFrame& f = _features.back();
+    if (f.boundedby == depth)
+      f.boundedby = 0;
+    if (f.depth == depth) {
+      for (int a = 0; a < LA_COUNT; a++) {
+        for (int lod = 0; lod <= 4; lod++) {
+          if (f.lods[a] & (1u << lod))
+            _stats.feature_lods[f.kind][a][lod]++;
+        }
+      }
+      _stats.feature_implicit[f.kind] += f.implicit;
+      _stats.feature_with_id[f.kind] += f.id;
+      _stats.feature_with_parts[f.kind] += f.parts;
+      _features.pop_back();
+    }
+  }
+  if (_thematic >= 0) {
+    if (_thematicdepth == depth) {
+      if (_thematic == TAG_WALLSURFACE - TAG_ROOFSURFACE)
+        _stats.wall_openings.add(_openings);
+      _thematic = -1;
+    }
+    else if (_thematicdepth + 1 == depth)
+      _thematiclod = 0;
+  }
+  if (_buildings.empty() == true)
+    return;
+  if ( (t == TAG_BOUNDEDBY) && (_buildings.back().boundedby == (long)depth) )
+    _buildings.back().boundedby = -1;
+  else if ( (t == TAG_BUILDING) && (_buildings.back().depth == depth) ) {
+    _stats.building_flags.push_back(_buildings.back().flags);
+    _buildings.pop_back();
+    if ( ( (_measure == true) || (_shapes == true) ) && (_buildings.empty() == true) )
+      end_building_measures();
+  }
+}
+
+
+ReportFilter::ReportFilter(std::map<std::string, std::string>& ns, int reports, bool skip, bool defer, Stats& stats) :
+  _stats(stats) {
+  std::vector<std::pair<Tag, std::string> > l;
+  tag_names(ns, l);
+  //-- keys point into _names, so it must not grow after this
+  _names.reserve(l.size());
+  for (auto& each : l) {
+    _names.push_back(each.second);
+    span key = { _names.back().c_str(), _names.back().size() };
+    _tags.insert(std::make_pair(key, each.first));
+  }
+  //-- the features only counted; the buildings and relief features are walked
+  //-- for the flags and components when their report is requested
+  std::fill(_skip, _skip + TAG_COUNT, true);
+  _skip[TAG_OTHER] = false;
+  for (int t = TAG_CONSISTSOFBUILDINGPART; t <= TAG_LOD4TERRAININTERSECTION; t++)
+    _skip[t] = false;
+  _skip[TAG_RELIEFCOMPONENT] = false;
+  if (reports & REPORT_BUILDING)
+    _skip[TAG_BUILDING] = _skip[TAG_BUILDINGPART] = false;
+  if (reports & REPORT_RELIEF)
+    _skip[TAG_RELIEFFEATURE] = false;
+  if (reports & REPORT_WATER) {
+    for (int t = TAG_WATERBODY; t <= TAG_WATERSURFACE; t++)
+      _skip[t] = false;
+  }
+  if (reports & REPORT_VEGETATION) {
+    for (Tag t : { TAG_SOLITARYVEGETATIONOBJECT, TAG_PLANTCOVER, TAG_IMPLICITGEOMETRY, TAG_RELATIVEGMLGEOMETRY })
+      _skip[t] = false;
+  }
+  if (reports & REPORT_TRANSPORTATION) {
+    for (int t = TAG_TRAFFICAREA; t <= TAG_AUXILIARYTRAFFICAREA; t++)
+      _skip[t] = false;
+  }
+  if (reports & REPORT_BRIDGE) {
+    for (int t = TAG_BRIDGE; t <= TAG_BRIDGEROOM; t++)
+      _skip[t] = false;
+  }
+  if (reports & REPORT_TUNNEL) {
+    for (int t = TAG_TUNNEL; t <= TAG_HOLLOWSPACE; t++)
+      _skip[t] = false;
+  }
+  if (reports & REPORT_CITYFURNITURE)
+    _skip[TAG_CITYFURNITURE] = false;
+  //-- the primitives and extent reports read the coordinates of all the
+  //-- geometry, the group report needs the ids of all the city objects
+  if ( (reads_coordinates(reports) == true) || (reports & REPORT_GROUP) ) {
+    std::fill(_skip, _skip + TAG_COUNT, false);
+    _skip[TAG_APPEARANCE] = true;
+  }
+  if (skip == false)
+    std::fill(_skip, _skip + TAG_COUNT, false);
+  _gml = ( (skip == true) && (reads_coordinates(reports) == false) ) ? ns["gml"] : "";
+  //-- the reports on the buildings only need to know these are there
+  std::fill(_defer, _defer + TAG_COUNT, false);
+  for (int t = TAG_LOD0FOOTPRINT; t <= TAG_LOD4TERRAININTERSECTION; t++)
+    _defer[t] = defer;
+  //-- the polygons of the thematic surfaces are counted: their outline is
+  //-- kept, the rings left out
+  std::fill(_outline, _outline + TAG_COUNT, false);
+  if (reports & REPORT_BUILDING) {
+    for (Tag t : { TAG_MULTISURFACE, TAG_COMPOSITESURFACE, TAG_POLYGON }) {
+      _outline[t] = true;
+      _skip[t] = false;
+    }
+  }
+}
+
+
+Tag ReportFilter::lookup(const char* name, size_t length) const {
+  span key = { name, length };
+  auto it = _tags.find(key);
+  return (it == _tags.end()) ? TAG_OTHER : it->second;
+}
+
+
+pugi::xml_filter_result ReportFilter::element(const char* name, size_t length) {
+  Tag t = lookup(name, length);
+  if (_defer[t] == true)
+    return pugi::filter_defer;
+  //-- gml objects (upper case, unlike their properties) are only geometry
+  bool geometry = (_gml.empty() == false) && (length > _gml.size()) &&
+                  (std::memcmp(name, _gml.data(), _gml.size()) == 0) &&
+                  (name[_gml.size()] >= 'A') && (name[_gml.size()] <= 'Z');
+  if ( (_skip[t] == false) && ( (geometry == false) || (_outline[t] == true) ) )
+    return pugi::filter_keep;
+  _stats.tags[t]++;
+  return pugi::filter_skip;
+}
+
+
+void ReportFilter::skipped(const char* name, size_t length) {
+  _stats.tags[lookup(name, length)]++;
+}
+
+
+void get_namespaces(const char** attrs, std::map<std::string, std::string>& ns, std::string& vcitygml) {
+  vcitygml = "";
+  for (; *attrs != NULL; attrs += 2) {
+    std::string name = attrs[0];
+    if (name.find("xmlns") != std::string::npos) {
+      // std::cout << attrs[0] << "=" << attrs[1] << std::endl;
+      std::string value = attrs[1];
+      std::string sns;
+      if (value.find("http://www.opengis.net/citygml/0") != std::string::npos) {
+        sns = "citygml";
+        vcitygml = "v0.4";
+      }
+      else if (value.find("http://www.opengis.net/citygml/1") != std::string::npos) {
+        sns = "citygml";
+        vcitygml = "v1.0";
+      }
+      else if (value.find("http://www.opengis.net/citygml/2") != std::string::npos) {
+        sns = "citygml";
+        vcitygml = "v2.0";
+      }
+      else if (value.find("http://www.opengis.net/gml") != std::string::npos)
+        sns = "gml";
+      else if (value.find("http://www.opengis.net/citygml/building") != std::string::npos)
+        sns = "building";
+      else if (value.find("http://www.opengis.net/citygml/relief") != std::string::npos)
+        sns = "dem";
+      else if (value.find("http://www.opengis.net/citygml/vegetation") != std::string::npos)
+        sns = "veg";
+      else if (value.find("http://www.opengis.net/citygml/waterbody") != std::string::npos)
+        sns = "wtr";
+      else if (value.find("http://www.opengis.net/citygml/landuse") != std::string::npos)
+        sns = "luse";
+      else if (value.find("http://www.opengis.net/citygml/transportation") != std::string::npos)
+        sns = "tran";      
+      else if (value.find("http://www.opengis.net/citygml/cityfurniture") != std::string::npos)
+        sns = "frn";      
+      else if (value.find("http://www.opengis.net/citygml/bridge") != std::string::npos)
+        sns = "brid";
+      else if (value.find("http://www.opengis.net/citygml/tunnel") != std::string::npos)
+        sns = "tun";
+      else if (value.find("http://www.opengis.net/citygml/cityobjectgroup") != std::string::npos)
+        sns = "grp";
+      else if (value.find("http://www.opengis.net/citygml/appearance") != std::string::npos)
+        sns = "app";      
+      else if (value.find("http://www.w3.org/1999/xlink") != std::string::npos)
+        sns = "xlink";
+      else
+        sns = "";
+      if (sns != "") {
+        size_t pos = name.find(":");
+        if (pos == std::string::npos) 
+          ns[sns] = "";
+        else 
+          ns[sns] = name.substr(pos + 1) + ":";
+      }    
+    }
+  }
+}
+
+
+void node_attributes(const pugi::xml_node& node, std::vector<const char*>& attrs) {
+  attrs.clear();
+  for (pugi::xml_attribute a = node.first_attribute(); a; a = a.next_attribute()) {
+    attrs.push_back(a.name());
+    attrs.push_back(a.value());
+  }
+  attrs.push_back(NULL);
+}
+
+
+pugi::xml_parse_result walk_document(const pugi::xml_node& root, StatsCollector& collector, bool expand) {
+  std::vector<const char*> attrs;
+  pugi::xml_parse_result r;
+  r.status = pugi::status_ok;
+  pugi::xml_node cur = root.first_child();
+  while (cur) {
+    bool iselement = (cur.type() == pugi::node_element);
+    if (iselement == true) {
+      node_attributes(cur, attrs);
+      collector.start_element(cur.name(), &attrs[0]);
+      if ( ( (expand == true) || (collector.needs_content() == true) ) && (cur.deferred() == true) ) {
+        pugi::xml_parse_result e = cur.expand();
+        if (r && !e)
+          r = e;
+      }
+      if (cur.first_child()) {
+        cur = cur.first_child();
+        continue;
+      }
+      collector.end_element();
+    }
+    else if (collector.reading_coordinates() == true) {
+      const char* v = cur.value();
+      collector.text(v, std::strlen(v));
+    }
+    //-- climb up until there is a next sibling, closing the elements left
+    while (!cur.next_sibling()) {
+      cur = cur.parent();
+      if (!cur || cur == root)
+        return r;
+      collector.end_element();
+    }
+    cur = cur.next_sibling();
+  }
+  return r;
+}
+
+
+pugi::xml_parse_result expand_deferred(const pugi::xml_node& root) {
+  pugi::xml_parse_result r;
+  r.status = pugi::status_ok;
+  pugi::xml_node cur = root.first_child();
+  while (cur) {
+    if (cur.deferred() == true) {
+      pugi::xml_parse_result e = cur.expand();
+      if (r && !e)
+        r = e;
+    }
+    if (cur.first_child()) {
+      cur = cur.first_child();
+      continue;
+    }
+    while (!cur.next_sibling()) {
+      cur = cur.parent();
+      if (!cur || cur == root)
+        return r;
+    }
+    cur = cur.next_sibling();
+  }
+  return r;
+}
+
+
+void walk_element(const pugi::xml_node& element, StatsCollector& collector) {
+  std::vector<const char*> attrs;
+  node_attributes(element, attrs);
+  collector.start_element(element.name(), &attrs[0]);
+  walk_document(element, collector);
+  collector.end_element();
+}
+
+
+bool read_coordinates(const pugi::xml_node& element, const std::string& gml, CoordinateReader& reader) {
+  int dimension = 0;
+  for (pugi::xml_node n = element; n && (dimension == 0); n = n.parent())
+    dimension = n.attribute("srsDimension").as_int();
+  if (std::strcmp(element.name(), (gml + "coordinates").c_str()) != 0)
+    reader.start_list((dimension > 0) ? dimension : 3);
+  else {
+    const char* cs = element.attribute("cs").value();
+    const char* ts = element.attribute("ts").value();
+    const char* decimal = element.attribute("decimal").value();
+    reader.start_tuples(dimension, *cs ? *cs : ',', *ts ? *ts : ' ', *decimal ? *decimal : '.');
+  }
+  for (pugi::xml_node c = element.first_child(); c; c = c.next_sibling()) {
+    if ( (c.type() == pugi::node_pcdata) || (c.type() == pugi::node_cdata) ) {
+      const char* v = c.value();
+      reader.append(v, std::strlen(v));
+    }
+  }
+  return reader.finish();
+}
+
+
+//-- opens the file and reads the root element with the namespaces
+bool open_stream(pugi::xml_pull_parser& reader, const char* path, std::map<std::string, std::string>& ns, std::string& vcitygml, pugi::xml_parse_result& r) {
+  r.status = pugi::status_ok;
+  if (reader.open(path) == false) {
+    r.status = reader.status();
+    return false;
+  }
+  pugi::xml_pull_event e = reader.next();
+  if (e != pugi::pull_start_element) {
+    r.status = (e == pugi::pull_error) ? reader.status() : pugi::status_no_document_element;
+    r.offset = reader.offset();
+    return false;
+  }
+  get_namespaces(reader.attributes(), ns, vcitygml);
+  return (vcitygml.empty() == false);
+}
+
+
+pugi::xml_parse_result stream_file(const char* path, std::map<std::string, std::string>& ns, std::string& vcitygml, int reports, Stats& stats) {
+  pugi::xml_parse_result r;
+  pugi::xml_pull_parser reader;
+  if (open_stream(reader, path, ns, vcitygml, r) == false)
+    return r;
+  StatsCollector collector(ns, reports, stats);
+  for (pugi::xml_pull_event e = pugi::pull_start_element; e != pugi::pull_end_document; e = reader.next()) {
+    if (e == pugi::pull_start_element)
+      collector.start_element(reader.name(), reader.attributes());
+    else if (e == pugi::pull_end_element)
+      collector.end_element();
+    else if ( (e == pugi::pull_pcdata) && (collector.reading_coordinates() == true) )
+      collector.text(reader.value(), reader.value_length());
+    else if (e == pugi::pull_error) {
+      r.status = reader.status();
+      r.offset = reader.offset();
+      break;
+    }
+  }
+  return r;
+}
+
+
+pugi::xml_parse_result window_file(const char* path, std::map<std::string, std::string>& ns, std::string& vcitygml, int reports, bool xpath, Stats& stats) {
+  pugi::xml_parse_result r;
+  pugi::xml_pull_parser reader;
+  if (open_stream(reader, path, ns, vcitygml, r) == false)
+    return r;
+  StatsCollector collector(ns, reports, stats);
+  collector.start_element(reader.name(), reader.attributes());
+  //-- each child of the root (core:cityObjectMember mostly) is rebuilt in
+  //-- this document, reported on, and thrown away
+  pugi::xml_document window;
+  pugi::xml_node cur = window;
+  std::string text;
+  for (pugi::xml_pull_event e = reader.next(); e != pugi::pull_end_document; e = reader.next()) {
+    if (e == pugi::pull_error) {
+      r.status = reader.status();
+      r.offset = reader.offset();
+      break;
+    }
+    if (e == pugi::pull_pcdata) {
+      text.append(reader.value(), reader.value_length());
+      continue;
+    }
+    if (text.empty() == false) {
+      if (cur != window)
+        cur.append_child(pugi::node_pcdata).set_value(text.c_str());
+      text.clear();
+    }
+    if (e == pugi::pull_start_element) {
+      cur = cur.append_child(reader.name());
+      for (const char** a = reader.attributes(); *a != NULL; a += 2)
+        cur.append_attribute(a[0]).set_value(a[1]);
+    }
+    else if (cur == window)
+      collector.end_element();
+    else {
+      cur = cur.parent();
+      if (cur == window) {
+        if (xpath == true) {
+          Stats s;
+          collect_xpath(window, ns, reports, s);
+          stats.merge(s);
+        }
+        else
+          walk_element(window.first_child(), collector);
+        window.reset();
+        cur = window;
+      }
+    }
+  }
+  return r;
+}
+
+
+//-- the queries only depend on the prefixes of these modules
+static const char* xpath_modules[] = {
+  "citygml", "building", "gml", "dem", "luse", "veg", "wtr", "app", "tran",
+  "brid", "tun", "frn", "grp", "xlink"
+};
+
+
+XPathQueries::XPathQueries(std::map<std::string, std::string>& ns) :
+  _ns(ns) {
+  //-- all the prefixes are looked up now, the map is only read afterwards
+  for (const char* each : xpath_modules)
+    _ns[each];
+  std::vector<std::pair<Tag, std::string> > l;
+  tag_names(_ns, l);
+  for (auto& each : l) {
+    _all[each.first].reset(new pugi::xpath_query(("//" + each.second).c_str()));
+    _tags[each.second] = each.first;
+  }
+  std::string s = "//" + _ns["building"] + "BuildingPart" + "[@" + _ns["gml"] + "id]";
+  _buildingpart_with_id.reset(new pugi::xpath_query(s.c_str()));
+  s = "//" + _ns["dem"] + "ReliefFeature" + "/" + _ns["dem"] + "reliefComponent";
+  _relief_component.reset(new pugi::xpath_query(s.c_str()));
+}
+
+
+Tag XPathQueries::tag(const char* name) const {
+  auto it = _tags.find(name);
+  return (it == _tags.end()) ? TAG_OTHER : it->second;
+}
+
+
+const XPathQueries& XPathQueries::get(std::map<std::string, std::string>& ns) {
+  static std::mutex                                           m;
+  static std::map<std::string, std::unique_ptr<XPathQueries> > registry;
+  std::string key;
+  for (const char* each : xpath_modules)
+    key += prefix(ns, each) + '\n';
+  std::lock_guard<std::mutex> lock(m);
+  std::unique_ptr<XPathQueries>& q = registry[key];
+  if (!q)
+    q.reset(new XPathQueries(ns));
+  return *q;
+}
+
+
+void collect_classes_xpath(pugi::xml_document& doc, const XPathQueries& q, Stats& stats) {
+  //-- only presence is probed here, the reports overwrite with the real numbers
+  static const Tag classes[] = {
+    TAG_BUILDING, TAG_RELIEFFEATURE, TAG_SOLITARYVEGETATIONOBJECT, TAG_PLANTCOVER,
+    TAG_WATERBODY, TAG_WATERCLOSURESURFACE, TAG_WATERGROUNDSURFACE, TAG_WATERSURFACE,
+    TAG_LANDUSE, TAG_APPEARANCE, TAG_TRAFFICAREA, TAG_TRANSPORTATIONCOMPLEX,
+    TAG_TRACK, TAG_RAILWAY, TAG_ROAD, TAG_SQUARE, TAG_AUXILIARYTRAFFICAREA,
+    TAG_BRIDGE, TAG_TUNNEL, TAG_CITYFURNITURE, TAG_CITYOBJECTGROUP
+  };
+  for (Tag t : classes)
+    stats.tags[t] = q.all(t).evaluate_exists(doc);
+}
+
+
+void collect_primitives_xpath(pugi::xml_document& doc, const XPathQueries& q, Stats& stats) {
+  static const Tag primitives[] = {
+    TAG_SOLID, TAG_MULTISOLID, TAG_COMPOSITESOLID, TAG_MULTISURFACE, TAG_COMPOSITESURFACE, TAG_POLYGON
+  };
+  for (Tag t : primitives)
+    stats.tags[t] = q.all(t).evaluate_count(doc);
+  CoordinateReader reader;
+  for (Tag t : { TAG_POS, TAG_POSLIST, TAG_COORDINATES }) {
+    pugi::xpath_node_set nc = q.all(t).evaluate_node_set(doc);
+    for (auto& c : nc) {
+      if (read_coordinates(c.node(), q.ns().at("gml"), reader) == true)
+        stats.points += reader.points();
+    }
+  }
+  //-- the distributions need each ring and polygon with its parts: the same
+  //-- walk as the walk engine
+  Stats scratch;
+  StatsCollector collector(q.ns(), REPORT_PRIMITIVES, scratch);
+  walk_document(doc, collector);
+  stats.ring_vertices = scratch.ring_vertices;
+  stats.polygon_rings = scratch.polygon_rings;
+  stats.building_polygons = scratch.building_polygons;
+  for (int lod = 1; lod <= 4; lod++)
+    stats.building_polygons_lod[lod] = scratch.building_polygons_lod[lod];
+}
+
+
+void collect_extent_xpath(pugi::xml_document& doc, const XPathQueries& q, Stats& stats) {
+  std::string boundedby = q.ns().at("gml") + "boundedBy";
+  CoordinateReader reader;
+  for (Tag t : { TAG_POS, TAG_POSLIST, TAG_COORDINATES, TAG_LOWERCORNER, TAG_UPPERCORNER }) {
+    pugi::xpath_node_set nc = q.all(t).evaluate_node_set(doc);
+    for (auto& c : nc) {
+      //-- the outermost city object and envelope above the coordinates
+      int cls = -1;
+      pugi::xml_node envelope;
+      for (pugi::xml_node a = c.node().parent(); a; a = a.parent()) {
+        Tag at = q.tag(a.name());
+        if (at == TAG_ENVELOPE)
+          envelope = a;
+        else if (extent_class(at) >= 0)
+          cls = extent_class(at);
+      }
+      if ( (t == TAG_LOWERCORNER || t == TAG_UPPERCORNER) && !envelope )
+        continue;
+      if (read_coordinates(c.node(), q.ns().at("gml"), reader) == false)
+        continue;
+      if (!envelope) {
+        stats.extent.add(reader.values(), reader.dimension());
+        if (cls >= 0)
+          stats.class_extent[cls].add(reader.values(), reader.dimension());
+        continue;
+      }
+      //-- gml:boundedBy of the root, or at the top of a window (which has no root)
+      pugi::xml_node b = envelope.parent();
+      if ( (boundedby == b.name()) &&
+           ( (b.parent().type() == pugi::node_document) || (b.parent().parent().type() == pugi::node_document) ) )
+        stats.declared.add(reader.values(), reader.dimension());
+    }
+  }
+}
+
+
+void collect_building_xpath(pugi::xml_document& doc, const XPathQueries& q, Stats& stats) {
+  static const Tag parts[] = {
+    TAG_BUILDINGPART, TAG_DOOR, TAG_WINDOW, TAG_BUILDINGINSTALLATION,
+    TAG_INTBUILDINGINSTALLATION, TAG_ROOM, TAG_BUILDINGFURNITURE
+  };
+  for (Tag t : parts)
+    stats.tags[t] = q.all(t).evaluate_count(doc);
+  stats.buildingpart_with_id = q.buildingpart_with_id().evaluate_count(doc);
+
+  //-- one descent per building fills its flags word; buildings nested in it
+  //-- are closed first, so the outer one is always the last word pushed
+  pugi::xpath_node_set nb = q.all(TAG_BUILDING).evaluate_node_set(doc);
+  stats.tags[TAG_BUILDING] = nb.size();
+  stats.building_flags.reserve(nb.size());
+  Stats scratch;
+  StatsCollector collector(q.ns(), REPORT_BUILDING, scratch);
+  for (auto& b : nb) {
+    walk_element(b.node(), collector);
+    stats.building_flags.push_back(scratch.building_flags.back());
+    scratch.building_flags.clear();
+    //-- the surfaces of a nested building are counted with the outer one
+    bool nested = false;
+    for (pugi::xml_node a = b.node().parent(); a && (nested == false); a = a.parent())
+      nested = (q.tag(a.name()) == TAG_BUILDING);
+    for (int i = 0; i < SURFACE_TYPES; i++) {
+      for (int lod = 0; lod <= 4; lod++) {
+        if (nested == false) {
+          stats.surfaces[i][lod] += scratch.surfaces[i][lod];
+          stats.surface_polygons[i][lod] += scratch.surface_polygons[i][lod];
+        }
+        scratch.surfaces[i][lod] = scratch.surface_polygons[i][lod] = 0;
+      }
+    }
+    if (nested == false)
+      stats.wall_openings.merge(scratch.wall_openings);
+    scratch.wall_openings = QuantileSketch();
+  }
+}
+
+
+void collect_geometry_xpath(pugi::xml_document& doc, const XPathQueries& q, Stats& stats) {
+  //-- the same measures as the walk, one building at a time; the buildings
+  //-- nested in another are measured with it
+  pugi::xpath_node_set nb = q.all(TAG_BUILDING).evaluate_node_set(doc);
+  Stats scratch;
+  StatsCollector collector(q.ns(), REPORT_GEOMETRY, scratch);
+  for (auto& b : nb) {
+    bool nested = false;
+    for (pugi::xml_node a = b.node().parent(); a && (nested == false); a = a.parent())
+      nested = (q.tag(a.name()) == TAG_BUILDING);
+    if (nested == false)
+      walk_element(b.node(), collector);
+  }
+  for (int lod = 1; lod <= 4; lod++) {
+    std::swap(stats.building_volume[lod], scratch.building_volume[lod]);
+    std::swap(stats.building_area[lod], scratch.building_area[lod]);
+  }
+}
+
+
+void collect_relief_xpath(pugi::xml_document& doc, const XPathQueries& q, Stats& stats) {
+  static const Tag relief[] = {
+    TAG_RELIEFFEATURE, TAG_TINRELIEF, TAG_RASTERRELIEF, TAG_MASSPOINTRELIEF, TAG_BREAKLINERELIEF, TAG_TRIANGLE
+  };
+  for (Tag t : relief)
+    stats.tags[t] = q.all(t).evaluate_count(doc);
+  stats.relief_component = q.relief_component().evaluate_count(doc);
+}
+
+
+void collect_landuse_xpath(pugi::xml_document& doc, const XPathQueries& q, Stats& stats) {
+  stats.tags[TAG_LANDUSE] = q.all(TAG_LANDUSE).evaluate_count(doc);
+}
+
+
+void collect_features_xpath(pugi::xml_document& doc, const XPathQueries& q, int reports, Stats& stats) {
+  static const Tag water[] = {
+    TAG_WATERBODY, TAG_WATERCLOSURESURFACE, TAG_WATERGROUNDSURFACE, TAG_WATERSURFACE
+  };
+  static const Tag vegetation[] = {
+    TAG_SOLITARYVEGETATIONOBJECT, TAG_PLANTCOVER, TAG_IMPLICITGEOMETRY, TAG_RELATIVEGMLGEOMETRY, TAG_LIBRARYOBJECT
+  };
+  if (reports & REPORT_WATER) {
+    for (Tag t : water)
+      stats.tags[t] = q.all(t).evaluate_count(doc);
+  }
+  if (reports & REPORT_VEGETATION) {
+    for (Tag t : vegetation)
+      stats.tags[t] = q.all(t).evaluate_count(doc);
+  }
+  if (reports & REPORT_TRANSPORTATION) {
+    for (int t = TAG_TRAFFICAREA; t <= TAG_AUXILIARYTRAFFICAREA; t++)
+      stats.tags[t] = q.all(Tag(t)).evaluate_count(doc);
+  }
+  if (reports & REPORT_BRIDGE) {
+    for (int t = TAG_BRIDGE; t <= TAG_BRIDGEROOM; t++)
+      stats.tags[t] = q.all(Tag(t)).evaluate_count(doc);
+  }
+  if (reports & REPORT_TUNNEL) {
+    for (int t = TAG_TUNNEL; t <= TAG_HOLLOWSPACE; t++)
+      stats.tags[t] = q.all(Tag(t)).evaluate_count(doc);
+  }
+  if (reports & REPORT_CITYFURNITURE)
+    stats.tags[TAG_CITYFURNITURE] = q.all(TAG_CITYFURNITURE).evaluate_count(doc);
+  if (reports & REPORT_GROUP) {
+    for (int t = TAG_CITYOBJECTGROUP; t <= TAG_GROUPPARENT; t++)
+      stats.tags[t] = q.all(Tag(t)).evaluate_count(doc);
+  }
+  //-- the lodN properties of each object, the references of the implicit
+  //-- geometries, and the ids and members of the groups: the same walk as the
+  //-- walk engine, the members being then looked up in the ids by hash
+  Stats scratch;
+  StatsCollector collector(q.ns(), reports & FEATURE_REPORTS, scratch);
+  walk_document(doc, collector);
+  for (int k = 0; k < FK_COUNT; k++) {
+    for (int a = 0; a < LA_COUNT; a++) {
+      for (int lod = 0; lod <= 4; lod++)
+        stats.feature_lods[k][a][lod] = scratch.feature_lods[k][a][lod];
+    }
+    stats.feature_implicit[k] = scratch.feature_implicit[k];
+    stats.feature_with_id[k] = scratch.feature_with_id[k];
+    stats.feature_with_parts[k] = scratch.feature_with_parts[k];
+  }
+  stats.object_ids.swap(scratch.object_ids);
+  stats.member_hrefs.swap(scratch.member_hrefs);
+  stats.member_inline = scratch.member_inline;
+  stats.implicit_inline = scratch.implicit_inline;
+  stats.implicit_referenced = scratch.implicit_referenced;
+  stats.implicit_prototypes.swap(scratch.implicit_prototypes);
+}
+
+
+void collect_xpath(pugi::xml_document& doc, std::map<std::string, std::string>& ns, int reports, Stats& stats) {
+  const XPathQueries& q = XPathQueries::get(ns);
+  if (reports & REPORT_CLASSES)
+    collect_classes_xpath(doc, q, stats);
+  if (reports & REPORT_PRIMITIVES)
+    collect_primitives_xpath(doc, q, stats);
+  if (reports & REPORT_EXTENT)
+    collect_extent_xpath(doc, q, stats);
+  if (reports & REPORT_GEOMETRY)
+    collect_geometry_xpath(doc, q, stats);
+  if (reports & REPORT_BUILDING)
+    collect_building_xpath(doc, q, stats);
+  if (reports & REPORT_RELIEF)
+    collect_relief_xpath(doc, q, stats);
+  if (reports & REPORT_LANDUSE)
+    collect_landuse_xpath(doc, q, stats);
+  if (reports & FEATURE_REPORTS)
+    collect_features_xpath(doc, q, reports, stats);
+}
@@ -0,0 +1,461 @@
+#ifndef CITYGMLINFO_STATS_H
+#define CITYGMLINFO_STATS_H
+
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <unordered_map>
+#include "pugixml.hpp"
+#include "coords.h"
+#include "geometry.h"
+#include "sketch.h"
+
+
+//-- which reports are requested
+enum Report {
+  REPORT_CLASSES    = 1 << 0,
+  REPORT_PRIMITIVES = 1 << 1,
+  REPORT_BUILDING   = 1 << 2,
+  REPORT_RELIEF     = 1 << 3,
+  REPORT_LANDUSE    = 1 << 4,
+  REPORT_EXTENT     = 1 << 5,
+  REPORT_GEOMETRY   = 1 << 6,
+  REPORT_WATER      = 1 << 7,
+  REPORT_VEGETATION = 1 << 8,
+  REPORT_TRANSPORTATION = 1 << 9,
+  REPORT_BRIDGE     = 1 << 10,
+  REPORT_TUNNEL     = 1 << 11,
+  REPORT_CITYFURNITURE = 1 << 12,
+  REPORT_GROUP      = 1 << 13
+};
+//-- the reports on the city objects other than buildings, relief and landuse
+const int   FEATURE_REPORTS = REPORT_WATER | REPORT_VEGETATION | REPORT_TRANSPORTATION |
+                              REPORT_BRIDGE | REPORT_TUNNEL | REPORT_CITYFURNITURE | REPORT_GROUP;
+//-- the reports that parse the coordinates of the geometry
+inline bool reads_coordinates(int reports) { return (reports & (REPORT_PRIMITIVES | REPORT_EXTENT | REPORT_GEOMETRY)) != 0; }
+
+//-- elements the reports are interested in, everything else is TAG_OTHER
+enum Tag {
+  TAG_OTHER = 0,
+  //-- building
+  TAG_BUILDING,
+  TAG_BUILDINGPART,
+  TAG_CONSISTSOFBUILDINGPART,
+  TAG_BOUNDEDBY,
+  TAG_ROOFSURFACE, TAG_WALLSURFACE, TAG_GROUNDSURFACE,
+  TAG_CLOSURESURFACE, TAG_OUTERCEILINGSURFACE, TAG_OUTERFLOORSURFACE,
+  TAG_DOOR, TAG_WINDOW,
+  TAG_BUILDINGINSTALLATION, TAG_INTBUILDINGINSTALLATION, TAG_ROOM, TAG_BUILDINGFURNITURE,
+  TAG_LOD0FOOTPRINT,
+  TAG_LOD0ROOFEDGE,
+  TAG_LOD1SOLID, TAG_LOD2SOLID, TAG_LOD3SOLID, TAG_LOD4SOLID,
+  TAG_LOD1MULTISURFACE, TAG_LOD2MULTISURFACE, TAG_LOD3MULTISURFACE, TAG_LOD4MULTISURFACE,
+  TAG_LOD1TERRAININTERSECTION, TAG_LOD2TERRAININTERSECTION, TAG_LOD3TERRAININTERSECTION, TAG_LOD4TERRAININTERSECTION,
+  //-- gml
+  TAG_SOLID,
+  TAG_MULTISOLID,
+  TAG_COMPOSITESOLID,
+  TAG_MULTISURFACE,
+  TAG_COMPOSITESURFACE,
+  TAG_POLYGON,
+  TAG_TRIANGLE,
+  TAG_LINEARRING,
+  TAG_POS,
+  TAG_POSLIST,
+  TAG_COORDINATES,
+  TAG_ENVELOPE,
+  TAG_LOWERCORNER,
+  TAG_UPPERCORNER,
+  //-- relief
+  TAG_RELIEFFEATURE,
+  TAG_RELIEFCOMPONENT,
+  TAG_TINRELIEF,
+  TAG_RASTERRELIEF,
+  TAG_MASSPOINTRELIEF,
+  TAG_BREAKLINERELIEF,
+  //-- landuse
+  TAG_LANDUSE,
+  //-- vegetation
+  TAG_SOLITARYVEGETATIONOBJECT,
+  TAG_PLANTCOVER,
+  //-- waterbody
+  TAG_WATERBODY,
+  TAG_WATERCLOSURESURFACE,
+  TAG_WATERGROUNDSURFACE,
+  TAG_WATERSURFACE,
+  //-- appearance
+  TAG_APPEARANCE,
+  //-- core
+  TAG_IMPLICITGEOMETRY,
+  TAG_RELATIVEGMLGEOMETRY,
+  TAG_LIBRARYOBJECT,
+  //-- transportation
+  TAG_TRAFFICAREA,
+  TAG_TRANSPORTATIONCOMPLEX,
+  TAG_TRACK,
+  TAG_RAILWAY,
+  TAG_ROAD,
+  TAG_SQUARE,
+  TAG_AUXILIARYTRAFFICAREA,
+  //-- bridge
+  TAG_BRIDGE,
+  TAG_BRIDGEPART,
+  TAG_CONSISTSOFBRIDGEPART,
+  TAG_BRIDGECONSTRUCTIONELEMENT,
+  TAG_BRIDGEINSTALLATION,
+  TAG_INTBRIDGEINSTALLATION,
+  TAG_BRIDGEROOM,
+  //-- tunnel
+  TAG_TUNNEL,
+  TAG_TUNNELPART,
+  TAG_CONSISTSOFTUNNELPART,
+  TAG_TUNNELINSTALLATION,
+  TAG_INTTUNNELINSTALLATION,
+  TAG_HOLLOWSPACE,
+  //-- cityfurniture
+  TAG_CITYFURNITURE,
+  //-- cityobjectgroup
+  TAG_CITYOBJECTGROUP,
+  TAG_GROUPMEMBER,
+  TAG_GROUPPARENT,
+  TAG_COUNT
+};
+
+//-- what is found inside one building:Building, as bit positions in its flags word
+enum BuildingFlag {
+  BF_FOOTPRINT = 0,
+  BF_ROOFEDGE  = 1,
+  BF_PART      = 2,
+  BF_ID        = 3,
+  //-- bits 4..19 per LOD, see below
+  BF_DOOR      = 20,
+  BF_WINDOW,
+  BF_INSTALLATION,
+  BF_INTINSTALLATION,
+  BF_ROOM,
+  BF_FURNITURE,
+  BF_COUNT
+};
+//-- per-LOD flags, LOD 1..4 each use 4 consecutive bits from bit 4
+inline int  bf_solid(int lod) { return 4 * lod; }
+inline int  bf_ms(int lod)    { return 4 * lod + 1; }
+inline int  bf_sem(int lod)   { return 4 * lod + 2; }
+inline int  bf_tic(int lod)   { return 4 * lod + 3; }
+
+//-- the thematic surfaces of the buildings (bldg:boundedBy), numbered in the order of their tags
+const int   SURFACE_TYPES = TAG_OUTERFLOORSURFACE - TAG_ROOFSURFACE + 1;
+inline bool is_surface(Tag t) { return (t >= TAG_ROOFSURFACE) && (t <= TAG_OUTERFLOORSURFACE); }
+
+//-- the city objects of the water, vegetation, transportation, bridge, tunnel
+//-- and city furniture reports, whose geometry is looked for in each LOD
+enum FeatureKind {
+  FK_WATERBODY = 0,
+  FK_SOLITARYVEGETATIONOBJECT,
+  FK_PLANTCOVER,
+  FK_TRANSPORTATION,              // TransportationComplex, Track, Railway, Road and Square
+  FK_TRAFFICAREA,
+  FK_AUXILIARYTRAFFICAREA,
+  FK_BRIDGE,
+  FK_BRIDGEPART,
+  FK_TUNNEL,
+  FK_TUNNELPART,
+  FK_CITYFURNITURE,
+  FK_COUNT
+};
+//-- what is counted per LOD for these objects, from their lodN properties
+enum LodAspect {
+  LA_GEOMETRY = 0,                // any lodN property but the terrain intersection
+  LA_SOLID,                       // lodNSolid
+  LA_MULTISURFACE,                // lodNMultiSurface
+  LA_SEMANTICS,                   // a lodNMultiSurface of a thematic surface (boundedBy)
+  LA_TIC,                         // lodNTerrainIntersection
+  LA_COUNT
+};
+//-- the kind of a city object of tag t, -1 if none
+int         feature_kind(Tag t);
+
+//-- the classes of city objects of which the extent is reported
+enum ExtentClass {
+  EC_BUILDING = 0,
+  EC_RELIEF,
+  EC_LANDUSE,
+  EC_WATER,
+  EC_VEGETATION,
+  EC_TRANSPORTATION,
+  EC_COUNT
+};
+//-- the class a city object of tag t is, -1 if none
+int         extent_class(Tag t);
+
+//-- a measure of the buildings: the compensated sum of the values and their
+//-- distribution, both mergeable in bounded memory
+struct Measure {
+  Sum            sum;
+  QuantileSketch values;
+  void add(double v)                  { sum.add(v); values.add(v); }
+  void merge(const Measure& other)    { sum.add(other.sum); values.merge(other.values); }
+};
+
+
+struct Stats {
+  size_t                    tags[TAG_COUNT];      // number of elements of each tag
+  size_t                    buildingpart_with_id;
+  size_t                    relief_component;     // dem:reliefComponent children of dem:ReliefFeature
+  size_t                    points;               // positions in gml:pos, gml:posList and gml:coordinates
+  QuantileSketch            ring_vertices;        // per gml:LinearRing
+  QuantileSketch            polygon_rings;        // per gml:Polygon
+  QuantileSketch            building_polygons;    // per building:Building
+  QuantileSketch            building_polygons_lod[5]; // per building:Building having polygons in that LOD
+  std::vector<unsigned int> building_flags;       // one word per building:Building, see BuildingFlag
+  size_t                    surfaces[SURFACE_TYPES][5];         // per LOD, thematic surfaces having a lodNMultiSurface
+  size_t                    surface_polygons[SURFACE_TYPES][5]; // and the gml:Polygon in it
+  QuantileSketch            wall_openings;        // Door and Window per bldg:WallSurface
+  size_t                    feature_lods[FK_COUNT][LA_COUNT][5]; // per LOD, city objects of each kind having each LodAspect
+  size_t                    feature_implicit[FK_COUNT];   // with a lodNImplicitRepresentation
+  size_t                    feature_with_id[FK_COUNT];
+  size_t                    feature_with_parts[FK_COUNT]; // Bridge and Tunnel with a consistsOf...Part
+  size_t                    implicit_inline;      // core:relativeGMLGeometry with the geometry in it
+  size_t                    implicit_referenced;  // core:relativeGMLGeometry reusing a geometry by xlink:href
+  std::set<std::string>     implicit_prototypes;  // the geometries reused
+  size_t                    prototypes;           // their number, once the file is finished
+  std::unordered_set<std::string> object_ids;     // gml:id of all but the gml objects, with the group report
+  std::vector<std::string>  member_hrefs;         // grp:groupMember by xlink:href, without the '#'
+  size_t                    member_inline;        // grp:groupMember holding the city object
+  size_t                    member_referenced;    // grp:groupMember by xlink:href, once the file is finished
+  size_t                    member_resolved;      // of them, those found in object_ids
+  Box                       extent;               // of all the coordinates, except those of the envelopes
+  Box                       class_extent[EC_COUNT];
+  Box                       declared;             // gml:boundedBy/gml:Envelope of the root
+  Measure                   building_volume[5];   // per LOD, of the building:Building having a lodNSolid
+  Measure                   building_area[5];     // per LOD, of the building:Building having polygons
+
+  Stats();
+  bool contains(Tag t) const { return tags[t] > 0; }
+  //-- adds the counters of another part of the file, or of another file once finished
+  void merge(const Stats& other);
+  //-- the whole file has been merged: the counters that depend on all its
+  //-- parts are fixed and what they were computed from is dropped, an
+  //-- xlink:href referring only within its own file
+  void finish_file();
+  //-- number of buildings having each flag set
+  void tally_buildings(size_t tally[BF_COUNT]) const;
+};
+
+
+//-- Receives start/end element events (expat-style, attrs is a NULL-terminated
+//-- array of name/value pairs) and updates the counters of all reports at once.
+//-- The text is only needed inside the coordinates, when the reports read them.
+class StatsCollector {
+public:
+  StatsCollector(const std::map<std::string, std::string>& ns, int reports, Stats& stats);
+  void start_element(const char* name, const char** attrs);
+  void end_element();
+  //-- a deferred content met now has to be expanded for the reports (the
+  //-- polygons of the thematic surfaces are counted)
+  bool needs_content() const { return _thematiclod > 0; }
+  void text(const char* s, size_t length) { _reader.append(s, length); }
+  bool reading_coordinates() const { return _coordinates >= 0; }
+  //-- the names are interned (pugi::parse_intern_names): equal names are the same
+  //-- pointer, so the tag of a name is looked up once and then found by address
+  void names_interned() { _interned = true; }
+
+private:
+  struct cstr_hash {
+    size_t operator()(const char* s) const {
+      size_t h = 2166136261u;
+      for (; *s; ++s)
+        h = (h ^ (unsigned char)*s) * 16777619u;
+      return h;
+    }
+  };
+  struct cstr_equal {
+    bool operator()(const char* a, const char* b) const { return std::strcmp(a, b) == 0; }
+  };
+  struct BuildingFrame {
+    size_t       depth;
+    long         boundedby;         // depth of the open boundedBy child, -1 if none
+    unsigned int flags;
+  };
+  struct PolygonMeasures {
+    double       area;
+    double       volume6;           // 6 times the signed volume of its cone from the origin
+  };
+  //-- the measures of the outermost building being read, per LOD: the area of
+  //-- its solids (with the polygons they reference by xlink:href) or else of
+  //-- its multi-surfaces, the volume of its solids, and its number of polygons
+  //-- (all LODs in [0])
+  struct BuildingGeometry {
+    double       origin[3];         // first point of the building, the points are taken relative to it
+    bool         hasorigin;
+    bool         solid[5];
+    bool         surface[5];
+    Sum          solidarea[5];
+    Sum          solidvolume6[5];
+    Sum          surfacearea[5];
+    size_t       polygoncount[5];
+    std::unordered_map<std::string, PolygonMeasures> polygons;  // by gml:id
+    std::vector<std::pair<int, std::string> >        hrefs;     // LOD of the solid and polygon referenced
+  };
+
+  Tag         lookup(const char* name);
+  bool        has_attribute(const char** attrs, const std::string& name) const;
+  const char* attribute(const char** attrs, const char* name) const;
+  void        start_coordinates(Tag t, const char** attrs);
+  void        start_measures(Tag t, size_t depth, const char** attrs);
+  void        end_measures(Tag t, size_t depth);
+  void        end_building_measures();
+
+  Stats&                                                    _stats;
+  std::vector<std::string>                                  _names;
+  std::unordered_map<const char*, Tag, cstr_hash, cstr_equal> _tags;
+  bool                                                      _interned;
+  std::unordered_map<const char*, Tag>                      _atoms;
+  std::string                                               _gmlid;
+  std::vector<Tag>                                          _stack;
+  std::vector<BuildingFrame>                                _buildings;
+  bool                                                      _semantics;   // the thematic surfaces are counted
+  int                                                       _thematic;    // type of the open thematic surface, -1 if none
+  size_t                                                    _thematicdepth;
+  int                                                       _thematiclod; // LOD of its own open lodNMultiSurface, 0 if none
+  size_t                                                    _openings;    // in the open thematic surface
+  struct FeatureFrame {
+    FeatureFrame(int k, size_t d);
+    int          kind;
+    size_t       depth;
+    size_t       boundedby;         // depth of its open boundedBy, 0 if none
+    unsigned int lods[LA_COUNT];    // bit N: LOD N
+    bool         implicit;
+    bool         id;
+    bool         parts;
+  };
+  void        feature_property(FeatureFrame& f, const char* name, size_t depth);
+
+  bool                                                      _lods;        // the LODs of the objects of FeatureKind are looked for
+  std::vector<FeatureFrame>                                 _features;
+  std::string                                               _gmlboundedby;
+  bool                                                      _groups;      // the ids of the city objects are indexed
+  std::string                                               _gmlprefix;
+  bool                                                      _geometry;    // the coordinates are read
+  long                                                      _coordinates; // depth of the open coordinates element, -1 if none
+  std::vector<std::pair<size_t, int> >                      _dimensions;  // depth and value of the srsDimension in effect
+  Tag                                                       _coordtag;    // pos, posList, coordinates or a corner
+  int                                                       _class;       // ExtentClass of the outermost city object open, -1 if none
+  size_t                                                    _classdepth;
+  long                                                      _envelope;    // depth of the open gml:Envelope, -1 if none
+  bool                                                      _declared;    // it is the one of the root
+  bool                                                      _measure;     // the volumes and areas of the buildings are computed
+  bool                                                      _shapes;      // the distributions of vertices, rings and polygons are computed
+  std::string                                               _href;
+  BuildingGeometry                                          _geom;
+  int                                                       _solidlod;    // LOD of the open lodNSolid, 0 if none
+  size_t                                                    _soliddepth;
+  int                                                       _surfacelod;  // LOD of the open lodNMultiSurface, 0 if none
+  size_t                                                    _surfacedepth;
+  long                                                      _polygon;     // depth of the open gml:Polygon, -1 if none
+  std::string                                               _polygonid;
+  double                                                    _normal[3];   // Newell vector of its rings
+  double                                                    _volume6;
+  size_t                                                    _polygonrings;
+  long                                                      _ring;        // depth of the open gml:LinearRing, -1 if none
+  std::vector<double>                                       _ringpoints;
+  size_t                                                    _ringvertices;
+  CoordinateReader                                          _reader;
+};
+
+
+//-- Parse filter (pugi::xml_document::set_parse_filter) that, with skip, leaves
+//-- out of the DOM the subtrees the walk engine does not need as a tree for the
+//-- requested reports: gml geometry, appearances and the features that are only
+//-- counted. The elements of a subtree left out are counted while it is stepped
+//-- over, so the counters of the reports stay the same.
+//-- With defer, the content of the geometry properties of the buildings
+//-- (lodNSolid, lodNMultiSurface, ...) is kept unparsed until it is expanded.
+class ReportFilter : public pugi::xml_parse_filter {
+public:
+  ReportFilter(std::map<std::string, std::string>& ns, int reports, bool skip, bool defer, Stats& stats);
+  pugi::xml_filter_result element(const char* name, size_t length);
+  void skipped(const char* name, size_t length);
+
+private:
+  struct span {
+    const char* s;
+    size_t      length;
+  };
+  struct span_hash {
+    size_t operator()(const span& n) const {
+      size_t h = 2166136261u;
+      for (size_t i = 0; i < n.length; i++)
+        h = (h ^ (unsigned char)n.s[i]) * 16777619u;
+      return h;
+    }
+  };
+  struct span_equal {
+    bool operator()(const span& a, const span& b) const {
+      return (a.length == b.length) && (std::memcmp(a.s, b.s, a.length) == 0);
+    }
+  };
+
+  Tag         lookup(const char* name, size_t length) const;
+
+  Stats&                                                _stats;
+  std::vector<std::string>                              _names;
+  std::unordered_map<span, Tag, span_hash, span_equal>  _tags;
+  bool                                                  _skip[TAG_COUNT];
+  bool                                                  _defer[TAG_COUNT];
+  bool                                                  _outline[TAG_COUNT];  // gml objects kept all the same
+  std::string                                           _gml;
+};
+
+
+//-- The queries of the xpath engine, compiled once for a set of namespace
+//-- prefixes instead of parsing the query string at every select_nodes().
+//-- They are only evaluated afterwards, so the windows, chunks and files that
+//-- use the same prefixes all share the instance returned by get().
+class XPathQueries {
+public:
+  static const XPathQueries& get(std::map<std::string, std::string>& ns);
+
+  const pugi::xpath_query&  all(Tag t) const   { return *_all[t]; }     // //qname
+  const pugi::xpath_query&  buildingpart_with_id() const { return *_buildingpart_with_id; }
+  const pugi::xpath_query&  relief_component() const     { return *_relief_component; }
+  //-- the tag of an element name, to look at the ancestors of a node
+  Tag                       tag(const char* name) const;
+  const std::map<std::string, std::string>& ns() const { return _ns; }
+
+private:
+  XPathQueries(std::map<std::string, std::string>& ns);
+  XPathQueries(const XPathQueries&);
+  XPathQueries& operator=(const XPathQueries&);
+
+  //-- every prefix of the key is in it, set by the constructor
+  std::map<std::string, std::string>          _ns;
+  std::unique_ptr<pugi::xpath_query>          _all[TAG_COUNT];
+  std::unique_ptr<pugi::xpath_query>          _buildingpart_with_id;
+  std::unique_ptr<pugi::xpath_query>          _relief_component;
+  std::unordered_map<std::string, Tag>        _tags;
+};
+
+
+//-- the CityGML modules declared on the root element, as "prefix:" (or "" for the default namespace)
+void        get_namespaces(const char** attrs, std::map<std::string, std::string>& ns, std::string& vcitygml);
+void        node_attributes(const pugi::xml_node& node, std::vector<const char*>& attrs);
+//-- one pass of the pull parser over the file, no DOM is built
+pugi::xml_parse_result stream_file(const char* path, std::map<std::string, std::string>& ns, std::string& vcitygml, int reports, Stats& stats);
+//-- same, but each child of the root is rebuilt as a small DOM on which the engine runs
+pugi::xml_parse_result window_file(const char* path, std::map<std::string, std::string>& ns, std::string& vcitygml, int reports, bool xpath, Stats& stats);
+//-- one preorder walk of the DOM feeding the collector, without/with the root itself;
+//-- with expand the deferred contents met are expanded and walked (the result is the first that is not well-formed)
+pugi::xml_parse_result walk_document(const pugi::xml_node& root, StatsCollector& collector, bool expand = false);
+void        walk_element(const pugi::xml_node& element, StatsCollector& collector);
+//-- the numbers of a gml:pos, gml:posList or gml:coordinates element, with the srsDimension in effect on it
+bool        read_coordinates(const pugi::xml_node& element, const std::string& gml, CoordinateReader& reader);
+//-- expands all the deferred contents below root (the result is the first that is not well-formed)
+pugi::xml_parse_result expand_deferred(const pugi::xml_node& root);
+//-- the original one-XPath-query-per-counter path
+void        collect_xpath(pugi::xml_document& doc, std::map<std::string, std::string>& ns, int reports, Stats& stats);
+
+#endif